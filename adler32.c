@@ -6,6 +6,11 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "cpu_features.h"
+
+#ifdef X86_CPU
+#  include <immintrin.h>
+#endif
 
 local uLong adler32_combine_ OF((uLong adler1, uLong adler2, z_off64_t len2));
 
@@ -66,7 +71,6 @@ uLong ZEXPORT adler32_z(adler, buf, len)
     z_size_t len;
 {
     unsigned long sum2;
-    unsigned n;
 
     /* split Adler-32 into component sums */
     sum2 = (adler >> 16) & 0xffff;
@@ -99,6 +103,26 @@ uLong ZEXPORT adler32_z(adler, buf, len)
         return adler | (sum2 << 16);
     }
 
+    /* use the fastest kernel for this processor for the rest */
+    z_cpu_check_features();
+    return z_kernels.adler32(adler | (sum2 << 16), buf, len);
+}
+
+/* =========================================================================
+ * The portable version of the adler32 kernel in z_kernels.
+ */
+uLong ZLIB_INTERNAL adler32_c(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    z_size_t len;
+{
+    unsigned long sum2;
+    unsigned n;
+
+    /* split Adler-32 into component sums */
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+
     /* do length NMAX blocks -- requires just one modulo operation */
     while (len >= NMAX) {
         len -= NMAX;
@@ -130,6 +154,143 @@ uLong ZEXPORT adler32_z(adler, buf, len)
     return adler | (sum2 << 16);
 }
 
+#ifdef X86_CPU
+
+/*
+   Over a block of n bytes x[0..n-1], the Adler-32 sums go from a and s to:
+
+        a' = a + x[0] + x[1] + ... + x[n-1]
+        s' = s + n a + n x[0] + (n-1) x[1] + ... + 1 x[n-1]
+
+   The vector kernels add up the bytes of each block with psadbw, and the
+   weighted sum of the bytes with pmaddubsw and pmaddwd, in several 32-bit
+   lanes.  n a is deferred to the end of the run, by adding up the a's at
+   the start of each block in their own lanes and multiplying that by n with
+   a shift.  The lanes are summed and the modulo taken once per run of up to
+   NMAX bytes, since each lane is no more than the total, which NMAX keeps
+   from overflowing.  adler32_c() does the last few bytes.
+ */
+
+/* Return the sum of the four 32-bit lanes of x. */
+#define HSUM(x) ( \
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0x4e)), \
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0xb1)), \
+    (unsigned long)(unsigned)_mm_cvtsi128_si32(x))
+
+/* =========================================================================
+ * The adler32 kernel for SSSE3, 32 bytes at a time.
+ */
+Z_TARGET("ssse3")
+uLong ZLIB_INTERNAL adler32_ssse3(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    z_size_t len;
+{
+    unsigned long sum2;
+    z_size_t n;
+    __m128i vs1, vs2, vps, x0, x1, zero, ones, w0, w1;
+
+    /* split Adler-32 into component sums */
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+
+    zero = _mm_setzero_si128();
+    ones = _mm_set1_epi16(1);
+    w0 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                       24, 23, 22, 21, 20, 19, 18, 17);
+    w1 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                       8, 7, 6, 5, 4, 3, 2, 1);
+    while (len >= 32) {
+        n = len < NMAX ? len : NMAX;
+        n &= ~(z_size_t)31;
+        len -= n;
+        vs1 = _mm_cvtsi32_si128((int)adler);
+        vs2 = _mm_cvtsi32_si128((int)sum2);
+        vps = zero;
+        do {
+            x0 = _mm_loadu_si128((const __m128i *)buf);
+            x1 = _mm_loadu_si128((const __m128i *)(buf + 16));
+            vps = _mm_add_epi32(vps, vs1);
+            vs1 = _mm_add_epi32(vs1, _mm_add_epi32(_mm_sad_epu8(x0, zero),
+                                                   _mm_sad_epu8(x1, zero)));
+            x0 = _mm_maddubs_epi16(x0, w0);
+            x1 = _mm_maddubs_epi16(x1, w1);
+            vs2 = _mm_add_epi32(vs2,
+                                _mm_madd_epi16(_mm_add_epi16(x0, x1), ones));
+            buf += 32;
+            n -= 32;
+        } while (n);
+        vs2 = _mm_add_epi32(vs2, _mm_slli_epi32(vps, 5));
+        adler = HSUM(vs1);
+        sum2 = HSUM(vs2);
+        MOD(adler);
+        MOD(sum2);
+    }
+    return adler32_c(adler | (sum2 << 16), buf, len);
+}
+
+/* =========================================================================
+ * The adler32 kernel for AVX2, 64 bytes at a time.
+ */
+Z_TARGET("avx2")
+uLong ZLIB_INTERNAL adler32_avx2(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    z_size_t len;
+{
+    unsigned long sum2;
+    z_size_t n;
+    __m256i vs1, vs2, vps, x0, x1, zero, ones, w0, w1;
+    __m128i x;
+
+    /* split Adler-32 into component sums */
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+
+    zero = _mm256_setzero_si256();
+    ones = _mm256_set1_epi16(1);
+    w0 = _mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57,
+                          56, 55, 54, 53, 52, 51, 50, 49,
+                          48, 47, 46, 45, 44, 43, 42, 41,
+                          40, 39, 38, 37, 36, 35, 34, 33);
+    w1 = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                          24, 23, 22, 21, 20, 19, 18, 17,
+                          16, 15, 14, 13, 12, 11, 10, 9,
+                          8, 7, 6, 5, 4, 3, 2, 1);
+    while (len >= 64) {
+        n = len < NMAX ? len : NMAX;
+        n &= ~(z_size_t)63;
+        len -= n;
+        vs1 = _mm256_setr_epi32((int)adler, 0, 0, 0, 0, 0, 0, 0);
+        vs2 = _mm256_setr_epi32((int)sum2, 0, 0, 0, 0, 0, 0, 0);
+        vps = zero;
+        do {
+            x0 = _mm256_loadu_si256((const __m256i *)buf);
+            x1 = _mm256_loadu_si256((const __m256i *)(buf + 32));
+            vps = _mm256_add_epi32(vps, vs1);
+            vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(x0, zero));
+            vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(x1, zero));
+            x0 = _mm256_madd_epi16(_mm256_maddubs_epi16(x0, w0), ones);
+            x1 = _mm256_madd_epi16(_mm256_maddubs_epi16(x1, w1), ones);
+            vs2 = _mm256_add_epi32(vs2, _mm256_add_epi32(x0, x1));
+            buf += 64;
+            n -= 64;
+        } while (n);
+        vs2 = _mm256_add_epi32(vs2, _mm256_slli_epi32(vps, 6));
+        x = _mm_add_epi32(_mm256_castsi256_si128(vs1),
+                          _mm256_extracti128_si256(vs1, 1));
+        adler = HSUM(x);
+        x = _mm_add_epi32(_mm256_castsi256_si128(vs2),
+                          _mm256_extracti128_si256(vs2, 1));
+        sum2 = HSUM(x);
+        MOD(adler);
+        MOD(sum2);
+    }
+    return adler32_c(adler | (sum2 << 16), buf, len);
+}
+
+#endif /* X86_CPU */
+
 /* ========================================================================= */
 uLong ZEXPORT adler32(adler, buf, len)
     uLong adler;
@@ -0,0 +1,230 @@
+/* bench9.c -- compare inflateBack9() speed with inflate() and inflateBack()
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* Usage: bench9 [file]
+
+   bench9 compresses the file, or generated text if no file is given, to raw
+   deflate data, and then decompresses that data over and over with inflate()
+   and inflateBack() as deflate, and with inflateBack9() as deflate64.  It
+   reports the speed of each in megabytes of output per second.
+
+   Deflate data is also deflate64 data with the same meaning as long as it
+   does not use length code 285, which is a length of 258 for deflate, and a
+   length with 16 extra bits for deflate64.  So bench9 cannot measure a file
+   with repeated strings of 258 bytes or more, such as long runs of zeros,
+   which zlib codes with that length code.  It checks that the data from
+   inflateBack9() is the same as the input, and if not it says so and stops.
+   The generated text has no such repeats.
+
+   Build from this directory after building zlib:
+
+        cc -O2 -I../.. -o bench9 bench9.c infback9.c inftree9.c inffast9.c \
+            ../../libz.a
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "zlib.h"
+#include "infback9.h"
+
+#define local static
+
+#define TEXT 8000000UL          /* bytes of generated text */
+#define SECS 2                  /* seconds to spend on each decoder */
+
+local unsigned char *comp;      /* compressed data */
+local unsigned long clen;       /* length of compressed data */
+local unsigned char *check;     /* data to compare the output to, or NULL */
+local unsigned long got;        /* bytes of output */
+local int diff;                 /* true if the output is not the same */
+
+/* in() for inflateBack() and inflateBack9() -- provide all of the input */
+local unsigned get(void *desc, z_const unsigned char **buf)
+{
+    (void)desc;
+    *buf = comp;
+    return (unsigned)clen;
+}
+
+/* out() for inflateBack() and inflateBack9() -- count and check the output */
+local int put(void *desc, unsigned char *buf, unsigned len)
+{
+    (void)desc;
+    if (check != NULL && memcmp(check + got, buf, len))
+        diff = 1;
+    got += len;
+    return 0;
+}
+
+/* Decode the compressed data once with the decoder which, and return the
+   number of bytes of output, or zero on error. */
+local unsigned long once(int which, unsigned char *out, unsigned long olen)
+{
+    int ret;
+    z_stream strm;
+    static unsigned char window[65536];
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    got = 0;
+    switch (which) {
+    case 0:
+        strm.next_in = Z_NULL;
+        strm.avail_in = 0;
+        if (inflateInit2(&strm, -15) != Z_OK)
+            return 0;
+        strm.next_in = comp;
+        strm.avail_in = (unsigned)clen;
+        strm.next_out = out;
+        strm.avail_out = (unsigned)olen;
+        ret = inflate(&strm, Z_FINISH);
+        got = strm.total_out;
+        inflateEnd(&strm);
+        break;
+    case 1:
+        if (inflateBackInit(&strm, 15, window) != Z_OK)
+            return 0;
+        ret = inflateBack(&strm, get, NULL, put, NULL);
+        inflateBackEnd(&strm);
+        break;
+    default:
+        if (inflateBack9Init(&strm, window) != Z_OK)
+            return 0;
+        ret = inflateBack9(&strm, get, NULL, put, NULL);
+        inflateBack9End(&strm);
+    }
+    return ret == Z_STREAM_END ? got : 0;
+}
+
+/* Generate len bytes of text from random words, which has no long repeated
+   strings. */
+local void text(unsigned char *buf, unsigned long len)
+{
+    static const char *words[] = {
+        "the", "of", "and", "a", "to", "in", "is", "you", "that", "it", "he",
+        "was", "for", "on", "are", "as", "with", "his", "they", "I", "at",
+        "be", "this", "have", "from", "or", "one", "had", "by", "word", "but",
+        "not", "what", "all", "were", "we", "when", "your", "can", "said",
+        "there", "use", "an", "each", "which", "she", "do", "how", "their",
+        "if", "will", "up", "other", "about", "out", "many", "then", "them",
+        "these", "so", "some", "her", "would", "make", "like", "him", "into",
+        "time", "has", "look", "two", "more", "write", "go", "see", "number",
+        "no", "way", "could", "people", "my", "than", "first", "water",
+        "been", "call", "who", "oil", "its", "now", "find", "long", "down",
+        "day", "did", "get", "come", "made", "may", "part"};
+    unsigned long n = 0;
+    size_t k;
+
+    srand(1);
+    while (n < len) {
+        k = (size_t)rand() % (sizeof(words) / sizeof(words[0]));
+        k = strlen(words[k]) < len - n ? k : 3;
+        memcpy(buf + n, words[k], strlen(words[k]));
+        n += strlen(words[k]);
+        if (n < len)
+            buf[n++] = rand() % 13 ? ' ' : '\n';
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int which;
+    unsigned long len, olen, n, reps;
+    unsigned char *data, *out;
+    double secs;
+    clock_t start;
+    z_stream strm;
+    FILE *in;
+    static const char *name[] = {"inflate()", "inflateBack()",
+                                 "inflateBack9()"};
+
+    /* get the data to compress */
+    if (argc > 2) {
+        fputs("usage: bench9 [file]\n"
+              "the file must not have repeated strings of 258 bytes or more,\n"
+              "which deflate64 codes differently\n", stderr);
+        return 1;
+    }
+    if (argc > 1) {
+        in = fopen(argv[1], "rb");
+        if (in == NULL || fseek(in, 0, SEEK_END) ||
+            (len = (unsigned long)ftell(in)) == 0 || fseek(in, 0, SEEK_SET)) {
+            fprintf(stderr, "bench9: could not read %s\n", argv[1]);
+            return 1;
+        }
+        data = malloc(len);
+        if (data == NULL || fread(data, 1, len, in) != len) {
+            fprintf(stderr, "bench9: could not read %s\n", argv[1]);
+            return 1;
+        }
+        fclose(in);
+    }
+    else {
+        len = TEXT;
+        data = malloc(len);
+        if (data == NULL) {
+            fprintf(stderr, "bench9: out of memory\n");
+            return 1;
+        }
+        text(data, len);
+    }
+
+    /* compress it to raw deflate data */
+    olen = len;
+    comp = malloc(deflateBound(NULL, len));
+    out = malloc(olen);
+    if (comp == NULL || out == NULL) {
+        fprintf(stderr, "bench9: out of memory\n");
+        return 1;
+    }
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "bench9: out of memory\n");
+        return 1;
+    }
+    strm.next_in = data;
+    strm.avail_in = (unsigned)len;
+    strm.next_out = comp;
+    strm.avail_out = (unsigned)deflateBound(NULL, len);
+    deflate(&strm, Z_FINISH);
+    clen = strm.total_out;
+    deflateEnd(&strm);
+    printf("%lu bytes compressed to %lu\n", len, clen);
+
+    /* check that it means the same thing as deflate64 data */
+    check = data;
+    diff = 0;
+    if (once(2, out, olen) != len || diff) {
+        fprintf(stderr, "bench9: input has repeats of 258 bytes or more, "
+                        "which deflate64 codes differently\n");
+        return 1;
+    }
+    check = NULL;
+
+    /* time each decoder */
+    for (which = 0; which < 3; which++) {
+        reps = 0;
+        start = clock();
+        do {
+            n = once(which, out, olen);
+            if (n != len) {
+                fprintf(stderr, "bench9: %s failed\n", name[which]);
+                return 1;
+            }
+            reps++;
+            secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+        } while (secs < SECS);
+        printf("%-15s %7.1f MB/s\n", name[which], reps * (len / 1e6) / secs);
+    }
+    free(out);
+    free(comp);
+    free(data);
+    return 0;
+}
@@ -7,6 +7,7 @@
 #include "infback9.h"
 #include "inftree9.h"
 #include "inflate9.h"
+#include "inffast9.h"
 
 #define WSIZE 65536UL
 
@@ -113,6 +114,37 @@ void makefixed9(void)
 
 /* Macros for inflateBack(): */
 
+/* Load returned state from inflate_fast9() */
+#define LOAD() \
+    do { \
+        put = strm->next_out; \
+        left = strm->avail_out; \
+        next = strm->next_in; \
+        have = strm->avail_in; \
+        hold = state->hold; \
+        bits = state->bits; \
+        mode = state->mode; \
+        length = state->length; \
+        offset = state->offset; \
+    } while (0)
+
+/* Set state from registers for inflate_fast9() */
+#define RESTORE() \
+    do { \
+        strm->next_out = put; \
+        strm->avail_out = (unsigned)left; \
+        strm->next_in = next; \
+        strm->avail_in = have; \
+        state->hold = hold; \
+        state->bits = bits; \
+        state->mode = mode; \
+        state->wrap = wrap; \
+        state->lencode = lencode; \
+        state->distcode = distcode; \
+        state->lenbits = lenbits; \
+        state->distbits = distbits; \
+    } while (0)
+
 /* Clear the input bit accumulator */
 #define INITBITS() \
     do { \
@@ -465,6 +497,15 @@ void FAR *out_desc;
             mode = LEN;
 
         case LEN:
+            /* use inflate_fast9() if we have enough input and output */
+            if (have >= INFLATE_FAST9_MIN_HAVE &&
+                left >= INFLATE_FAST9_MIN_LEFT) {
+                RESTORE();
+                inflate_fast9(strm);
+                LOAD();
+                break;
+            }
+
             /* get a literal, length, or end-of-block code */
             for (;;) {
                 here = lencode[BITS(lenbits)];
@@ -556,7 +597,9 @@ void FAR *out_desc;
                 break;
             }
             Tracevv((stderr, "inflate:         distance %lu\n", offset));
+            mode = MATCH;
 
+        case MATCH:
             /* copy match from window to output */
             do {
                 ROOM();
@@ -576,6 +619,7 @@ void FAR *out_desc;
                     *put++ = *from++;
                 } while (--copy);
             } while (length != 0);
+            mode = LEN;
             break;
 
         case DONE:
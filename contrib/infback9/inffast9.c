@@ -0,0 +1,369 @@
+/* inffast9.c -- fast decoding of deflate64 data, adapted from inffast.c
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "zutil.h"
+#include "inffast.h"
+#include "inftree9.h"
+#include "inflate9.h"
+#include "inffast9.h"
+
+#ifdef BIT64
+/* Return the eight bytes at p as a little-endian 64-bit integer. */
+local BIT64 load64 OF((z_const unsigned char FAR *p));
+local BIT64 load64(p)
+z_const unsigned char FAR *p;
+{
+    BIT64 w;
+#  if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+      || defined(_WIN64)
+    zmemcpy((Bytef *)&w, (Bytef *)p, 8);
+#  else
+    int n;
+
+    w = 0;
+    for (n = 7; n >= 0; n--)
+        w = (w << 8) + p[n];
+#  endif
+    return w;
+}
+
+/* Fill the 64-bit bit buffer with the eight bytes at in, and advance in past
+   the bytes that fit entirely.  This leaves 56 to 63 bits in hold. */
+#  define REFILL() \
+    do { \
+        hold |= load64(in) << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#endif
+
+#ifdef INFLATE_CHUNK
+/* Copy one chunk from from to out through a temporary, so that the two may
+   overlap.  Compilers turn this into a load and a store. */
+#define CHUNK(out, from) \
+    do { \
+        unsigned char chunk[INFLATE_CHUNK]; \
+        zmemcpy(chunk, from, INFLATE_CHUNK); \
+        zmemcpy(out, chunk, INFLATE_CHUNK); \
+    } while (0)
+
+/* Copy len bytes from from to out a chunk at a time, and return out + len.
+   from must not be in the INFLATE_CHUNK bytes before out, so that each chunk
+   read has already been written.  The last bytes are copied one at a time,
+   since the bytes after the match in the window are history that a later
+   match can still copy. */
+local unsigned char FAR *chunk_copy OF((unsigned char FAR *out,
+                                        unsigned char FAR *from,
+                                        unsigned len));
+local unsigned char FAR *chunk_copy(out, from, len)
+unsigned char FAR *out;
+unsigned char FAR *from;
+unsigned len;
+{
+    while (len >= INFLATE_CHUNK) {
+        CHUNK(out, from);
+        out += INFLATE_CHUNK;
+        from += INFLATE_CHUNK;
+        len -= INFLATE_CHUNK;
+    }
+    while (len) {
+        *out++ = *from++;
+        len--;
+    }
+    return out;
+}
+
+/* Copy the len bytes that start dist bytes back from out to out, and return
+   out + len.  If dist is less than a chunk, the first chunk is copied a byte
+   at a time, which repeats the pattern, and the rest is copied from the
+   multiple of dist bytes back that is at least a chunk. */
+local unsigned char FAR *chunk_repeat OF((unsigned char FAR *out,
+                                          unsigned dist, unsigned len));
+local unsigned char FAR *chunk_repeat(out, dist, len)
+unsigned char FAR *out;
+unsigned dist;
+unsigned len;
+{
+    unsigned char FAR *from;
+    unsigned n;
+
+    from = out - dist;
+    if (dist < INFLATE_CHUNK) {
+        n = len < INFLATE_CHUNK ? len : INFLATE_CHUNK;
+        len -= n;
+        do {
+            *out++ = *from++;
+        } while (--n);
+        if (len == 0)
+            return out;
+        n = dist;
+        do {
+            n += dist;
+        } while (n < INFLATE_CHUNK);
+        from = out - n;
+    }
+    return chunk_copy(out, from, len);
+}
+#endif
+
+/*
+   Decode deflate64 literal, length, and distance codes into the window of
+   inflateBack9() until either not enough input or output is available, an
+   end-of-block is encountered, a length too long for the output left is
+   encountered, or a data error is encountered.  This is inflate_fast() for
+   the deflate64 codes, and for a 64K window that is the output itself.
+
+   Entry assumptions:
+
+        state->mode == LEN
+        strm->avail_in >= INFLATE_FAST9_MIN_HAVE (8, or 15 with BIT64)
+        strm->avail_out >= INFLATE_FAST9_MIN_LEFT (258)
+        strm->next_out + strm->avail_out is the end of the window
+        state->bits < 8
+
+   On return, state->mode is one of:
+
+        LEN -- ran out of enough output space or enough available input
+        MATCH -- state->length bytes from state->offset back are left to copy
+        TYPE -- reached end of block code, inflateBack9() to interpret next
+        BAD -- error in block data
+
+   Notes:
+
+    - Deflate64 differs from deflate in three ways: the window is 64K, length
+      code 285 has 16 extra bits for a length up to 65538, and distance codes
+      30 and 31 have 14 extra bits for distances up to 65536.  inftree9.c
+      marks lengths and distances with op values of 128 plus the extra bits,
+      since there can be 16 of those.
+
+    - The maximum input bits used by a length/distance pair is 15 bits for the
+      length code, 16 bits for the length extra, 15 bits for the distance
+      code, and 14 bits for the distance extra.  This totals 60 bits.
+
+    - With a 64-bit bit buffer, eight input bytes are loaded at once at the
+      start of each loop, which leaves 56 to 63 bits in hold.  That is enough
+      for a literal or length code with its extra bits.  It is refilled again
+      before the distance only if there are fewer than 29 bits left for it,
+      which takes a long length code with many extra bits, as for the 16
+      extra bits of code 285.
+
+    - The maximum bytes that a length/distance pair outputs is 65538.  Only
+      258 are assured, so a longer length that does not fit in the rest of
+      the window is left in state->length and state->offset for the MATCH
+      mode of inflateBack9(), which writes out the window as it fills.
+
+    - With INFLATE_CHUNK defined, matches are copied a chunk at a time, but
+      never past the end of the match, since the bytes after out are the
+      oldest history in the window.  See inffast.c.
+ */
+void ZLIB_INTERNAL inflate_fast9(strm)
+z_streamp strm;
+{
+    struct inflate_state FAR *state;
+    z_const unsigned char FAR *in;      /* local strm->next_in */
+    z_const unsigned char FAR *last;    /* have enough input while in < last */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+    unsigned char FAR *window;  /* start of the window */
+    unsigned char FAR *wend;    /* end of the window */
+    int wrap;                   /* true if the window has wrapped */
+#ifdef BIT64
+    BIT64 hold;                 /* local strm->hold */
+#else
+    unsigned long hold;         /* local strm->hold */
+#endif
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code here;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST9_MIN_HAVE - 1));
+    out = strm->next_out;
+    end = out + (strm->avail_out - (INFLATE_FAST9_MIN_LEFT - 1));
+    window = state->window;
+    wend = out + strm->avail_out;
+    wrap = state->wrap;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+#ifdef BIT64
+        REFILL();
+#else
+        if (bits < 15) {
+            hold += (unsigned long)(*in++) << bits;
+            bits += 8;
+            hold += (unsigned long)(*in++) << bits;
+            bits += 8;
+        }
+#endif
+        here = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(here.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here.op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, here.val >= 0x20 && here.val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", here.val));
+            *out++ = (unsigned char)(here.val);
+        }
+        else if ((op & 0xc0) == 0x80) {         /* length base */
+            len = (unsigned)(here.val);
+            op &= 31;                           /* number of extra bits */
+            if (op) {
+#ifndef BIT64
+                if (bits < op) {
+                    hold += (unsigned long)(*in++) << bits;
+                    bits += 8;
+                    if (bits < op) {
+                        hold += (unsigned long)(*in++) << bits;
+                        bits += 8;
+                    }
+                }
+#endif
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+#ifdef BIT64
+            if (bits < 29)
+                REFILL();
+#else
+            if (bits < 15) {
+                hold += (unsigned long)(*in++) << bits;
+                bits += 8;
+                hold += (unsigned long)(*in++) << bits;
+                bits += 8;
+            }
+#endif
+            here = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(here.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here.op);
+            if ((op & 0xc0) == 0x80) {          /* distance base */
+                dist = (unsigned)(here.val);
+                op &= 31;                       /* number of extra bits */
+#ifndef BIT64
+                if (bits < op) {
+                    hold += (unsigned long)(*in++) << bits;
+                    bits += 8;
+                    if (bits < op) {
+                        hold += (unsigned long)(*in++) << bits;
+                        bits += 8;
+                    }
+                }
+#endif
+                dist += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - window);  /* max distance in output */
+                if (dist > op && !wrap) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+                if (len > (unsigned)(wend - out)) {
+                    state->length = len;        /* let inflateBack9() write */
+                    state->offset = dist;       /*  out the window as needed */
+                    state->mode = MATCH;
+                    break;
+                }
+                if (dist > op) {                /* some from end of window */
+                    op = dist - op;
+                    from = wend - op;
+                    if (op > len)
+                        op = len;
+                    len -= op;
+#ifdef INFLATE_CHUNK
+                    out = chunk_copy(out, from, op);
+#else
+                    do {
+                        *out++ = *from++;
+                    } while (--op);
+#endif
+                    if (len == 0)
+                        continue;
+                }
+#ifdef INFLATE_CHUNK
+                out = chunk_repeat(out, dist, len);
+#else
+                from = out - dist;              /* copy direct from output */
+                while (len > 2) {
+                    *out++ = *from++;
+                    *out++ = *from++;
+                    *out++ = *from++;
+                    len -= 3;
+                }
+                if (len) {
+                    *out++ = *from++;
+                    if (len > 1)
+                        *out++ = *from++;
+                }
+#endif
+            }
+            else if ((op & 0xf0) == 0) {        /* 2nd level distance code */
+                here = dcode[here.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 0xf0) == 0) {            /* 2nd level length code */
+            here = lcode[here.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1U << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST9_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST9_MIN_HAVE - 1) - (in - last));
+    strm->avail_out = (unsigned)(wend - out);
+    state->hold = (unsigned long)hold;
+    state->bits = bits;
+    return;
+}
@@ -0,0 +1,23 @@
+/* inffast9.h -- header to use inffast9.c
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/* inflate_fast9() may be called only when at least INFLATE_FAST9_MIN_HAVE
+   bytes of input and INFLATE_FAST9_MIN_LEFT bytes of output are available.
+   A deflate64 length/distance pair can take 60 bits.  With a 64-bit bit
+   buffer that may need two eight-byte loads, the second up to seven bytes
+   after the first.  Otherwise it is read a byte at a time, at most eight
+   bytes for a pair. */
+#ifdef BIT64
+#  define INFLATE_FAST9_MIN_HAVE 15
+#else
+#  define INFLATE_FAST9_MIN_HAVE 8
+#endif
+#define INFLATE_FAST9_MIN_LEFT 258
+
+void ZLIB_INTERNAL inflate_fast9 OF((z_streamp strm));
@@ -14,6 +14,7 @@ typedef enum {
         STORED,     /* i: waiting for stored size (length and complement) */
         TABLE,      /* i: waiting for dynamic block table lengths */
             LEN,        /* i: waiting for length/lit code */
+            MATCH,      /* o: waiting for output space to copy string */
     DONE,       /* finished check, done -- remain here until reset */
     BAD         /* got a data error -- remain here until reset */
 } inflate_mode;
@@ -28,13 +29,27 @@ typedef enum {
             STORED -> TYPE
             TABLE -> LENLENS -> CODELENS -> LEN
     Read deflate codes:
-                LEN -> LEN or TYPE
+                LEN -> LEN or MATCH or TYPE
+                MATCH -> LEN
  */
 
 /* state maintained between inflate() calls.  Approximately 7K bytes. */
 struct inflate_state {
+    inflate_mode mode;          /* current inflate mode */
         /* sliding window */
     unsigned char FAR *window;  /* allocated sliding window, if needed */
+    int wrap;                   /* true if the window has wrapped */
+        /* bit accumulator */
+    unsigned long hold;         /* input bit accumulator */
+    unsigned bits;              /* number of bits in "in" */
+        /* for string and stored block copying */
+    unsigned long length;       /* literal or length of data to copy */
+    unsigned long offset;       /* distance back to copy string from */
+        /* fixed and dynamic code tables */
+    code const FAR *lencode;    /* starting table for length/literal codes */
+    code const FAR *distcode;   /* starting table for distance codes */
+    unsigned lenbits;           /* index bits for lencode */
+    unsigned distbits;          /* index bits for distcode */
         /* dynamic table building */
     unsigned ncode;             /* number of code length code lengths */
     unsigned nlen;              /* number of length code lengths */
@@ -0,0 +1,174 @@
+/* cpu_features.c -- processor feature detection for optimized kernels
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* @(#) $Id$ */
+
+/*
+  The optimized kernels in deflate.c and elsewhere are compiled for the
+  instruction set extensions they use, whether or not the compiler's target
+  has them.  Which of them are used is decided at run time from the features
+  found here, so that a single build of the library runs the best kernels on
+  the processor it lands on.  The choices are made once, in z_kernels, which
+  the rest of the library calls through.  Compile with -DNO_SIMD to leave all
+  of this out and use only the portable C kernels.
+ */
+
+#include "cpu_features.h"
+
+#ifdef X86_CPU
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+unsigned ZLIB_INTERNAL z_cpu_features = 0;
+
+z_kernels_t ZLIB_INTERNAL z_kernels = {
+    crc32_c,
+    adler32_c,
+    compare256_c,
+#ifndef POS32
+    slide_table_c,
+#endif
+    syncscan_c
+};
+
+local volatile int cpu_features_unknown = 1;
+
+local void select_kernels OF((void));
+#ifdef X86_CPU
+local void x86_cpuid OF((unsigned leaf, unsigned subleaf, unsigned *regs));
+local unsigned x86_xgetbv OF((void));
+
+/* ===========================================================================
+ * Put eax, ebx, ecx, and edx for cpuid leaf and subleaf in regs[0..3].
+ */
+local void x86_cpuid(leaf, subleaf, regs)
+    unsigned leaf;
+    unsigned subleaf;
+    unsigned *regs;
+{
+#ifdef _MSC_VER
+    int r[4];
+
+    __cpuidex(r, (int)leaf, (int)subleaf);
+    regs[0] = (unsigned)r[0];
+    regs[1] = (unsigned)r[1];
+    regs[2] = (unsigned)r[2];
+    regs[3] = (unsigned)r[3];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/* ===========================================================================
+ * Return the low word of the XCR0 register, which has the register states
+ * that the operating system saves on a context switch.  The instruction is
+ * written out as bytes for assemblers that do not know it.
+ */
+local unsigned x86_xgetbv()
+{
+#ifdef _MSC_VER
+    return (unsigned)_xgetbv(0);
+#else
+    unsigned eax, edx;
+
+    __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0"
+                          : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+#endif
+}
+#endif /* X86_CPU */
+
+/* ===========================================================================
+ * Put the fastest kernels for the features in z_cpu_features in z_kernels.
+ */
+local void select_kernels()
+{
+#ifdef X86_CPU
+#  ifdef X86_VPCLMUL
+    if (cpu_has(CPU_VPCLMUL))
+        z_kernels.crc32 = crc32_vpclmul;
+    else
+#  endif
+    if (cpu_has(CPU_PCLMUL))
+        z_kernels.crc32 = crc32_pclmul;
+    if (cpu_has(CPU_AVX2))
+        z_kernels.adler32 = adler32_avx2;
+    else if (cpu_has(CPU_SSSE3))
+        z_kernels.adler32 = adler32_ssse3;
+    if (cpu_has(CPU_AVX2)) {
+        z_kernels.compare256 = compare256_avx2;
+#  ifndef POS32
+        z_kernels.slide_table = slide_table_avx2;
+#  endif
+        z_kernels.syncscan = syncscan_avx2;
+    }
+    else if (cpu_has(CPU_SSE2)) {
+        z_kernels.compare256 = compare256_sse2;
+#  ifndef POS32
+        z_kernels.slide_table = slide_table_sse2;
+#  endif
+        z_kernels.syncscan = syncscan_sse2;
+    }
+#endif
+#if defined(ARM_NEON) && !defined(POS32)
+    z_kernels.slide_table = slide_table_neon;
+#endif
+}
+
+/* ========================================================================= */
+void ZLIB_INTERNAL z_cpu_check_features()
+{
+    static volatile int first = 1;      /* flag to limit concurrent checking */
+    unsigned features = 0;
+
+    if (!cpu_features_unknown)
+        return;
+
+    /* See if another task is already doing this -- the result would be the
+       same, so wait for it rather than doing it again */
+    if (first) {
+        first = 0;
+#ifdef X86_CPU
+        {
+            unsigned regs[4], max, xcr0 = 0;
+
+            x86_cpuid(0, 0, regs);
+            max = regs[0];
+            if (max >= 1) {
+                x86_cpuid(1, 0, regs);
+                if (regs[3] & (1U << 26))
+                    features |= CPU_SSE2;
+                if (regs[2] & (1U << 9))
+                    features |= CPU_SSSE3;
+                if (regs[2] & (1U << 20))
+                    features |= CPU_SSE42;
+                if (regs[2] & (1U << 1))
+                    features |= CPU_PCLMUL;
+                if ((regs[2] & (1U << 27)) != 0)    /* OSXSAVE */
+                    xcr0 = x86_xgetbv();
+            }
+            if (max >= 7 && (xcr0 & 6) == 6) {      /* XMM and YMM state */
+                x86_cpuid(7, 0, regs);
+                if (regs[1] & (1U << 5))
+                    features |= CPU_AVX2;
+                if ((xcr0 & 0xe0) == 0xe0 &&        /* opmask and ZMM state */
+                    (regs[1] & (1U << 16)) && (regs[2] & (1U << 10)))
+                    features |= CPU_VPCLMUL;
+            }
+        }
+#endif
+        z_cpu_features = features;
+        select_kernels();
+        cpu_features_unknown = 0;
+    }
+    else {      /* not first */
+        /* wait for the other guy to finish (not efficient, but rare) */
+        while (cpu_features_unknown)
+            ;
+    }
+}
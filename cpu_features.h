@@ -0,0 +1,134 @@
+/* cpu_features.h -- processor feature detection for optimized kernels
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include "zutil.h"
+
+/* define NO_SIMD when compiling to use only the portable C code, with no
+   processor-specific kernels and no run-time feature detection.  Otherwise
+   X86_CPU is defined when the compiler can build code for instruction set
+   extensions that the target of the compilation does not necessarily have,
+   with Z_TARGET() applied to each function that uses them.  Those functions
+   must only be called after z_cpu_check_features() reports the feature. */
+#ifndef NO_SIMD
+#  if defined(__x86_64__) || defined(__i386__) || \
+      defined(_M_X64) || defined(_M_IX86)
+#    if defined(__clang__) || (defined(__GNUC__) && \
+        (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#      define X86_CPU
+#      define Z_TARGET(f) __attribute__((target(f)))
+#    elif defined(_MSC_VER) && _MSC_VER >= 1800
+#      define X86_CPU
+#      define Z_TARGET(f)
+#    endif
+#  endif
+#  if defined(__aarch64__) || defined(_M_ARM64)
+#    define ARM_NEON    /* always present on 64-bit ARM, no check needed */
+#  endif
+#endif
+
+/* X86_VPCLMUL is defined when the compiler also knows the carry-less multiply
+   of 512-bit vectors. */
+#ifdef X86_CPU
+#  if (defined(__clang__) && __clang_major__ >= 6) || \
+      (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8) || \
+      (defined(_MSC_VER) && _MSC_VER >= 1920)
+#    define X86_VPCLMUL
+#  endif
+#endif
+
+/* Bits in z_cpu_features */
+#define CPU_SSE2    0x0001      /* SSE2 */
+#define CPU_AVX2    0x0002      /* AVX2, with operating system support */
+#define CPU_SSE42   0x0004      /* SSE4.2, for the crc32 instruction */
+#define CPU_PCLMUL  0x0008      /* carry-less multiply of 64-bit words */
+#define CPU_VPCLMUL 0x0010      /* the same on 512-bit vectors, with AVX-512F
+                                   and operating system support */
+#define CPU_SSSE3   0x0020      /* SSSE3 */
+
+extern unsigned ZLIB_INTERNAL z_cpu_features;
+
+/* The kernels that have versions for different processors, each of which is
+   described where it is defined.  z_kernels starts with the portable C
+   versions, and z_cpu_check_features() replaces them with the fastest ones
+   that the processor can run. */
+typedef struct z_kernels_s {
+    unsigned long (*crc32) OF((unsigned long crc, const unsigned char FAR *buf,
+                               z_size_t len));          /* crc32.c */
+    uLong (*adler32) OF((uLong adler, const Bytef *buf,
+                         z_size_t len));                /* adler32.c */
+    unsigned (*compare256) OF((const Bytef *scan,
+                               const Bytef *match));    /* deflate.c */
+#ifndef POS32
+    void (*slide_table) OF((voidpf table, unsigned entries,
+                            uInt wsize));               /* deflate.c */
+#endif
+    z_size_t (*syncscan) OF((const unsigned char FAR *buf,
+                             z_size_t len));            /* inflate.c */
+} z_kernels_t;
+
+extern z_kernels_t ZLIB_INTERNAL z_kernels;
+
+void ZLIB_INTERNAL z_cpu_check_features OF((void));
+/* Set z_cpu_features and z_kernels, if they have not been set already.  This
+   is safe to call from several threads at once, since they would all set the
+   same values, and each kernel pointer is always one that works. */
+
+#define cpu_has(f) ((z_cpu_features & (f)) != 0)
+
+/* The kernel versions to choose from. */
+unsigned long ZLIB_INTERNAL crc32_c OF((unsigned long crc,
+                                        const unsigned char FAR *buf,
+                                        z_size_t len));
+uLong ZLIB_INTERNAL adler32_c OF((uLong adler, const Bytef *buf,
+                                  z_size_t len));
+unsigned ZLIB_INTERNAL compare256_c OF((const Bytef *scan,
+                                        const Bytef *match));
+#ifndef POS32
+void ZLIB_INTERNAL slide_table_c OF((voidpf table, unsigned entries,
+                                     uInt wsize));
+#endif
+z_size_t ZLIB_INTERNAL syncscan_c OF((const unsigned char FAR *buf,
+                                      z_size_t len));
+#ifdef X86_CPU
+unsigned long ZLIB_INTERNAL crc32_pclmul OF((unsigned long crc,
+                                             const unsigned char FAR *buf,
+                                             z_size_t len));
+#  ifdef X86_VPCLMUL
+unsigned long ZLIB_INTERNAL crc32_vpclmul OF((unsigned long crc,
+                                              const unsigned char FAR *buf,
+                                              z_size_t len));
+#  endif
+uLong ZLIB_INTERNAL adler32_ssse3 OF((uLong adler, const Bytef *buf,
+                                      z_size_t len));
+uLong ZLIB_INTERNAL adler32_avx2 OF((uLong adler, const Bytef *buf,
+                                     z_size_t len));
+unsigned ZLIB_INTERNAL compare256_sse2 OF((const Bytef *scan,
+                                           const Bytef *match));
+unsigned ZLIB_INTERNAL compare256_avx2 OF((const Bytef *scan,
+                                           const Bytef *match));
+#  ifndef POS32
+void ZLIB_INTERNAL slide_table_sse2 OF((voidpf table, unsigned entries,
+                                        uInt wsize));
+void ZLIB_INTERNAL slide_table_avx2 OF((voidpf table, unsigned entries,
+                                        uInt wsize));
+#  endif
+z_size_t ZLIB_INTERNAL syncscan_sse2 OF((const unsigned char FAR *buf,
+                                         z_size_t len));
+z_size_t ZLIB_INTERNAL syncscan_avx2 OF((const unsigned char FAR *buf,
+                                         z_size_t len));
+#endif
+#if defined(ARM_NEON) && !defined(POS32)
+void ZLIB_INTERNAL slide_table_neon OF((voidpf table, unsigned entries,
+                                        uInt wsize));
+#endif
+
+#endif /* CPU_FEATURES_H */
@@ -29,6 +29,14 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "cpu_features.h"
+
+#ifdef X86_CPU
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  endif
+#endif
 
 /* Definitions for doing the crc four data bytes at a time. */
 #if !defined(NOBYFOUR) && defined(Z_U4)
@@ -44,6 +52,17 @@
 #  define TBLS 1
 #endif /* BYFOUR */
 
+#ifdef X86_CPU
+   local z_crc_t crc32_fold OF((__m128i *x, const unsigned char FAR *buf,
+                                z_size_t len));
+   local z_crc_t fold_pclmul OF((z_crc_t crc, const unsigned char FAR *buf,
+                                 z_size_t len));
+#  ifdef X86_VPCLMUL
+   local z_crc_t fold_vpclmul OF((z_crc_t crc, const unsigned char FAR *buf,
+                                  z_size_t len));
+#  endif
+#endif
+
 /* Local functions for crc concatenation */
 local unsigned long gf2_matrix_times OF((unsigned long *mat,
                                          unsigned long vec));
@@ -211,6 +230,19 @@ unsigned long ZEXPORT crc32_z(crc, buf, len)
         make_crc_table();
 #endif /* DYNAMIC_CRC_TABLE */
 
+    z_cpu_check_features();
+    return z_kernels.crc32(crc, buf, len);
+}
+
+/* =========================================================================
+ * The CRC using the tables, which is the portable version of the crc32 kernel
+ * in z_kernels, and which finishes the others.
+ */
+unsigned long ZLIB_INTERNAL crc32_c(crc, buf, len)
+    unsigned long crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
 #ifdef BYFOUR
     if (sizeof(void *) == sizeof(ptrdiff_t)) {
         z_crc_t endian;
@@ -338,6 +370,194 @@ local unsigned long crc32_big(crc, buf, len)
 
 #endif /* BYFOUR */
 
+#ifdef X86_CPU
+
+/*
+   The CRC of a message is the message times x^32 modulo the polynomial p, in
+   the bit-reflected order described above for make_crc_table().  Multiplying
+   128 bits of the message by x^n modulo p moves them n bits further along,
+   where they can be exclusive-ored with the message there without changing
+   the CRC.  That fold is two carry-less multiplies of the two 64-bit halves,
+   by x^(n+32) and x^(n-32) modulo p, reflected and shifted up a bit to line
+   up with the product.  Four 128-bit remainders are folded forward 512 bits
+   at a time over the message, so that the multiplies overlap, and then into
+   one.  Two more multiplies reduce that to 64 bits, and a Barrett reduction
+   gets the final 32.  This follows Gopal et al., "Fast CRC Computation for
+   Generic Polynomials Using PCLMULQDQ Instruction", Intel, 2009.
+
+   The constants are each two 64-bit halves, given as 32-bit words from the
+   low end.  fold_pclmul() and fold_vpclmul() take and return the CRC
+   register, which is the one's complement of the CRC, and need len to be a
+   multiple of 16 that is at least 64, or at least 256 for fold_vpclmul().
+ */
+#define K(a, b, c, d) _mm_setr_epi32((int)(a), (int)(b), (int)(c), (int)(d))
+#define FOLD512 K(0x54442bd4, 1, 0xc6e41596, 1)     /* n = 512 */
+#define FOLD128 K(0x751997d0, 1, 0xccaa009e, 0)     /* n = 128 */
+#define FOLD64  K(0x63cd6124, 1, 0, 0)              /* x^64 */
+#define BARRETT K(0xdb710641, 1, 0xf7011641, 1)     /* p and x^64 / p */
+#define FOLD2048 K(0x1542778a, 1, 0x322d1430, 1)    /* n = 2048 */
+
+/* Return x * k(n) exclusive-ored with y, which folds x forward n bits onto
+   y for the constant k(n). */
+#define FOLD(x, k, y) _mm_xor_si128(_mm_xor_si128( \
+    _mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), y)
+
+/* ========================================================================= */
+/* Continue folding the four remainders in x over len bytes at buf, where len
+   is a multiple of 16, and return the CRC register. */
+Z_TARGET("pclmul")
+local z_crc_t crc32_fold(x, buf, len)
+    __m128i *x;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    __m128i x0, x1, x2, x3, k, mask;
+
+    /* fold four at a time */
+    x0 = x[0];
+    x1 = x[1];
+    x2 = x[2];
+    x3 = x[3];
+    k = FOLD512;
+    while (len >= 64) {
+        x0 = FOLD(x0, k, _mm_loadu_si128((const __m128i *)buf));
+        x1 = FOLD(x1, k, _mm_loadu_si128((const __m128i *)(buf + 16)));
+        x2 = FOLD(x2, k, _mm_loadu_si128((const __m128i *)(buf + 32)));
+        x3 = FOLD(x3, k, _mm_loadu_si128((const __m128i *)(buf + 48)));
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold into one, and then over what is left */
+    k = FOLD128;
+    x0 = FOLD(x0, k, x1);
+    x0 = FOLD(x0, k, x2);
+    x0 = FOLD(x0, k, x3);
+    while (len) {
+        x0 = FOLD(x0, k, _mm_loadu_si128((const __m128i *)buf));
+        buf += 16;
+        len -= 16;
+    }
+
+    /* reduce 128 bits to 64, then 64 to 32 */
+    mask = K(0xffffffff, 0, 0xffffffff, 0);
+    x0 = _mm_xor_si128(_mm_clmulepi64_si128(x0, k, 0x10),
+                       _mm_srli_si128(x0, 8));
+    x1 = _mm_srli_si128(x0, 4);
+    x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask), FOLD64, 0x00);
+    x0 = _mm_xor_si128(x0, x1);
+    k = BARRETT;
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask), k, 0x10);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x00);
+    x0 = _mm_xor_si128(x0, x1);
+    return (z_crc_t)_mm_cvtsi128_si32(_mm_srli_si128(x0, 4));
+}
+
+/* ========================================================================= */
+/* Fold 16 bytes at a time. */
+Z_TARGET("pclmul")
+local z_crc_t fold_pclmul(crc, buf, len)
+    z_crc_t crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    __m128i x[4];
+
+    x[0] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)buf),
+                         _mm_cvtsi32_si128((int)crc));
+    x[1] = _mm_loadu_si128((const __m128i *)(buf + 16));
+    x[2] = _mm_loadu_si128((const __m128i *)(buf + 32));
+    x[3] = _mm_loadu_si128((const __m128i *)(buf + 48));
+    return crc32_fold(x, buf + 64, len - 64);
+}
+
+#ifdef X86_VPCLMUL
+/* Return x * k(n) exclusive-ored with y for four 128-bit lanes at once. */
+#define FOLD4(x, k, y) _mm512_ternarylogic_epi64( \
+    _mm512_clmulepi64_epi128(x, k, 0x00), \
+    _mm512_clmulepi64_epi128(x, k, 0x11), y, 0x96)
+
+/* ========================================================================= */
+/* Fold 64 bytes at a time, with four 512-bit vectors of four remainders each
+   folded forward 2048 bits at a time.  Those are folded into one vector by
+   512 bits at a time, leaving the four remainders for crc32_fold(). */
+Z_TARGET("avx512f,vpclmulqdq,pclmul")
+local z_crc_t fold_vpclmul(crc, buf, len)
+    z_crc_t crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    __m512i z0, z1, z2, z3, k;
+    __m128i x[4];
+
+    z0 = _mm512_xor_si512(_mm512_loadu_si512((const void *)buf),
+                          _mm512_castsi128_si512(
+                              _mm_cvtsi32_si128((int)crc)));
+    z1 = _mm512_loadu_si512((const void *)(buf + 64));
+    z2 = _mm512_loadu_si512((const void *)(buf + 128));
+    z3 = _mm512_loadu_si512((const void *)(buf + 192));
+    buf += 256;
+    len -= 256;
+    k = _mm512_broadcast_i32x4(FOLD2048);
+    while (len >= 256) {
+        z0 = FOLD4(z0, k, _mm512_loadu_si512((const void *)buf));
+        z1 = FOLD4(z1, k, _mm512_loadu_si512((const void *)(buf + 64)));
+        z2 = FOLD4(z2, k, _mm512_loadu_si512((const void *)(buf + 128)));
+        z3 = FOLD4(z3, k, _mm512_loadu_si512((const void *)(buf + 192)));
+        buf += 256;
+        len -= 256;
+    }
+    k = _mm512_broadcast_i32x4(FOLD512);
+    z1 = FOLD4(z0, k, z1);
+    z2 = FOLD4(z1, k, z2);
+    z3 = FOLD4(z2, k, z3);
+    x[0] = _mm512_extracti32x4_epi32(z3, 0);
+    x[1] = _mm512_extracti32x4_epi32(z3, 1);
+    x[2] = _mm512_extracti32x4_epi32(z3, 2);
+    x[3] = _mm512_extracti32x4_epi32(z3, 3);
+    return crc32_fold(x, buf, len);
+}
+#endif /* X86_VPCLMUL */
+
+/* ========================================================================= */
+/* The crc32 kernels for processors with carry-less multiplies, which fold all
+   but the last few bytes, and leave those to crc32_c(). */
+unsigned long ZLIB_INTERNAL crc32_pclmul(crc, buf, len)
+    unsigned long crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    z_size_t n;
+
+    if (len >= 64) {
+        n = len & ~(z_size_t)15;
+        crc = ~fold_pclmul(~(z_crc_t)crc, buf, n) & 0xffffffffUL;
+        buf += n;
+        len -= n;
+    }
+    return crc32_c(crc, buf, len);
+}
+
+#ifdef X86_VPCLMUL
+unsigned long ZLIB_INTERNAL crc32_vpclmul(crc, buf, len)
+    unsigned long crc;
+    const unsigned char FAR *buf;
+    z_size_t len;
+{
+    z_size_t n;
+
+    if (len >= 256) {
+        n = len & ~(z_size_t)15;
+        crc = ~fold_vpclmul(~(z_crc_t)crc, buf, n) & 0xffffffffUL;
+        buf += n;
+        len -= n;
+    }
+    return crc32_pclmul(crc, buf, len);
+}
+#endif /* X86_VPCLMUL */
+
+#endif /* X86_CPU */
+
 #define GF2_DIM 32      /* dimension of GF(2) vectors (length of CRC) */
 
 /* ========================================================================= */
@@ -50,6 +50,51 @@
 /* @(#) $Id$ */
 
 #include "deflate.h"
+#include "cpu_features.h"
+
+#ifdef X86_CPU
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  endif
+#endif
+#ifdef ARM_NEON
+#  include <arm_neon.h>
+#endif
+
+/* MATCH_WORD is a 64-bit type for comparing strings eight bytes at a time,
+   and MATCH_DIFF(d) is the number of equal leading bytes in the two words
+   whose exclusive-or is d, which must not be zero. */
+#if defined(__GNUC__) && defined(__LP64__) && defined(__BYTE_ORDER__)
+#  define MATCH_WORD unsigned long
+#  if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#    define MATCH_DIFF(d) ((unsigned)__builtin_ctzl(d) >> 3)
+#  else
+#    define MATCH_DIFF(d) ((unsigned)__builtin_clzl(d) >> 3)
+#  endif
+#endif
+
+/* PREFETCH(p) asks for the cache line at p to be loaded ahead of its use, so
+   that the wait for it overlaps other work.  p need not be a valid address.
+   Compile with -DNO_PREFETCH to leave the hints out. */
+#if defined(NO_PREFETCH)
+#  define PREFETCH(p)
+#elif defined(__GNUC__) || defined(__clang__)
+#  define PREFETCH(p) __builtin_prefetch((const void *)(p))
+#elif defined(X86_CPU) && defined(_MSC_VER)
+#  define PREFETCH(p) _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#else
+#  define PREFETCH(p)
+#endif
+
+#ifdef X86_CPU
+#  ifdef _MSC_VER
+#    define FIRST_ONE(x) first_one(x)
+     local unsigned first_one OF((unsigned x));
+#  else
+#    define FIRST_ONE(x) ((unsigned)__builtin_ctz(x))
+#  endif
+#endif
 
 const char deflate_copyright[] =
    " deflate 1.2.11 Copyright 1995-2017 Jean-loup Gailly and Mark Adler ";
@@ -79,15 +124,41 @@ local void fill_window    OF((deflate_state *s));
 local block_state deflate_stored OF((deflate_state *s, int flush));
 local block_state deflate_fast   OF((deflate_state *s, int flush));
 #ifndef FASTEST
+local block_state deflate_quick  OF((deflate_state *s, int flush));
+local block_state deflate_medium OF((deflate_state *s, int flush));
+local uInt medium_match   OF((deflate_state *s, IPos hash_head, uInt prev));
 local block_state deflate_slow   OF((deflate_state *s, int flush));
+local uInt tree_matches   OF((deflate_state *s, IPos str, uInt most,
+                              ushf *pairs));
+local block_state deflate_optimal OF((deflate_state *s, int flush));
+local uInt opt_matches    OF((deflate_state *s, IPos str, IPos cur_match,
+                              uInt most, ushf *pairs));
+local uInt opt_parse      OF((deflate_state *s, uInt n));
+local uInt opt_path       OF((deflate_state *s, uInt n, const ush *lit,
+                              const ush *dist, int past));
+local ulg opt_stats       OF((deflate_state *s, uInt n, ush *lit, ush *dist));
+local void opt_costs      OF((ulg *freq, ush *cost, int n));
+local ulg opt_log2        OF((ulg x));
 #endif
+local int opt_alloc       OF((z_streamp strm));
+local int tree_alloc      OF((z_streamp strm));
 local block_state deflate_rle    OF((deflate_state *s, int flush));
 local block_state deflate_huff   OF((deflate_state *s, int flush));
+local uInt hash_multiply  OF((deflate_state *s, uInt str));
+#ifdef X86_CPU
+local uInt hash_crc32c    OF((deflate_state *s, uInt str));
+#endif
 local void lm_init        OF((deflate_state *s));
 local void putShortMSB    OF((deflate_state *s, uInt b));
 local void flush_pending  OF((z_streamp strm));
 local unsigned read_buf   OF((z_streamp strm, Bytef *buf, unsigned size));
+local void window_own     OF((deflate_state *s));
+local Bytef *putsaved     OF((Bytef *next, ulg val, int n));
+local ulg getsaved        OF((const Bytef **next, int n));
 #ifdef ASMV
+#  ifdef POS32
+#    error The assembler longest_match() does not support POS32
+#  endif
 #  pragma message("Assembler code may have bugs -- use at your own risk")
       void match_init OF((void)); /* asm code initialization */
       uInt longest_match  OF((deflate_state *s, IPos cur_match));
@@ -112,8 +183,38 @@ local  void check_match OF((deflate_state *s, IPos start, IPos match,
 #endif
 /* Matches of length 3 are discarded if their distance exceeds TOO_FAR */
 
+#define OPT_CHUNK 16384
+/* Most bytes of input parsed at once by deflate_optimal(), not counting up to
+ * MAX_MATCH-1 more that the last step of the parse can take in
+ */
+
+#define OPT_NODES (OPT_CHUNK + MAX_MATCH)
+/* Positions in opt[] */
+
+#define OPT_PAIRS (OPT_CHUNK * 4)
+/* Room for the matches found in a chunk. The chunk is cut short if there may
+ * not be room for all of the matches at the next position.
+ */
+
+#define OPT_MATCH_SIZE (2 * OPT_PAIRS + L_CODES + D_CODES)
+/* Size of opt_match in ush's, which is followed by opt_cost */
+
+#define OPT_BIT 256
+/* Cost of one bit in the cost models of deflate_optimal(), a power of two */
+
+#define LEN_EXTRA(code) ((code) < 8 || (code) == LENGTH_CODES-1 ? 0 : \
+                         ((code) - 4) >> 2)
+#define DIST_EXTRA(code) ((code) < 4 ? 0 : ((code) - 2) >> 1)
+/* Extra bits for each length code and distance code, as in trees.c */
+
+#define MAX_LEVEL 10
+/* Highest compression level. Level 10 is more than Z_BEST_COMPRESSION and is
+ * far slower, using deflate_optimal(). Under FASTEST all levels but 0 are the
+ * same as level 1.
+ */
+
 /* Values for max_lazy_match, good_match and max_chain_length, depending on
- * the desired pack level (0..9). The values given below have been tuned to
+ * the desired pack level (0..10). The values given below have been tuned to
  * exclude worst case performance for pathological files. Better values may be
  * found for specific files.
  */
@@ -131,24 +232,53 @@ local const config configuration_table[2] = {
 /* 0 */ {0,    0,  0,    0, deflate_stored},  /* store only */
 /* 1 */ {4,    4,  8,    4, deflate_fast}}; /* max speed, no lazy matches */
 #else
-local const config configuration_table[10] = {
+local const config configuration_table[MAX_LEVEL+1] = {
 /*      good lazy nice chain */
 /* 0 */ {0,    0,  0,    0, deflate_stored},  /* store only */
-/* 1 */ {4,    4,  8,    4, deflate_fast}, /* max speed, no lazy matches */
+/* 1 */ {4,    4,  8,    4, deflate_fast},  /* max speed, no lazy matches */
 /* 2 */ {4,    5, 16,    8, deflate_fast},
 /* 3 */ {4,    6, 32,   32, deflate_fast},
 
-/* 4 */ {4,    4, 16,   16, deflate_slow},  /* lazy matches */
-/* 5 */ {8,   16, 32,   32, deflate_slow},
-/* 6 */ {8,   16, 128, 128, deflate_slow},
+/* 4 */ {4,    4, 16,   16, deflate_medium}, /* look-ahead matches */
+/* 5 */ {8,   16, 32,   32, deflate_medium},
+/* 6 */ {8,   16, 128, 128, deflate_slow},  /* lazy matches */
 /* 7 */ {8,   32, 128, 256, deflate_slow},
 /* 8 */ {32, 128, 258, 1024, deflate_slow},
-/* 9 */ {32, 258, 258, 4096, deflate_slow}}; /* max compression */
+/* 9 */ {32, 258, 258, 4096, deflate_slow},  /* max compression */
+/* 10 */ {0,    3, 258,  512, deflate_optimal}}; /* optimal parsing */
+#endif
+
+/* Whether deflate_quick() takes the place of deflate_fast() for the level and
+ * strategy. It writes only static blocks as it goes, so it is used for level
+ * 1 when the application asks for static codes with Z_FIXED.
+ */
+#ifdef FASTEST
+#  define USE_QUICK(level, strategy) 0
+#else
+#  define USE_QUICK(level, strategy) ((level) == 1 && (strategy) == Z_FIXED)
+#endif
+
+/* Whether the tree match finder is used for the match method and level. It
+ * serves deflate_slow() and deflate_optimal() at levels 7 to 10, when asked
+ * for with Z_MATCH_TREE. It is not the default, since the hash chains are
+ * faster for most data at those levels, and the tree takes 2 * w_size more
+ * Pos. For the tree, max_chain is instead the most strings visited per
+ * position, including those visited only to insert the string.
+ */
+#ifdef FASTEST
+#  define USE_TREE(method, level) 0
+#else
+#  define USE_TREE(method, level) ((method) == Z_MATCH_TREE && (level) >= 7)
 #endif
 
 /* Note: the deflate() code requires max_lazy >= MIN_MATCH and max_chain >= 4
  * For deflate_fast() (levels <= 3) good is ignored and lazy has a different
- * meaning.
+ * meaning. deflate_quick() (level 1 with Z_FIXED) uses none of them, since it
+ * only checks the most recent string with the same hash for a match.
+ * deflate_medium() (levels 4 and 5) uses lazy only to decide when to also look
+ * one byte ahead.
+ * For deflate_optimal() (level 10) good is ignored and lazy is the
+ * most passes made over each chunk of input to refine the parse.
  */
 
 /* rank Z_BLOCK between Z_NO_FLUSH and Z_PARTIAL_FLUSH */
@@ -162,6 +292,31 @@ local const config configuration_table[10] = {
  */
 #define UPDATE_HASH(s,h,c) (h = (((h)<<s->hash_shift) ^ (c)) & s->hash_mask)
 
+/* ===========================================================================
+ * Set ins_h to the hash key of the string at window index str. For the
+ * default hash this is UPDATE_HASH with the last byte of the string, with the
+ * same assertion of consecutive calls. The hashes set by deflateSetHash() are
+ * instead computed from the four bytes at str alone.
+ */
+#define HASH_STRING(s, str) \
+   (s->hash_calc == Z_NULL ? \
+    UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]) : \
+    (s->ins_h = (*s->hash_calc)(s, str)))
+
+/* ===========================================================================
+ * Convert between window indices and the values stored in head[] and prev[].
+ * POS_INDEX() returns NIL for entries that have slid out of the window.
+ */
+#ifdef POS32
+#  define POS_BASE(s) ((s)->pos_base)
+#  define POS_INDEX(s, p) \
+     ((ulg)(p) > (s)->pos_base ? (IPos)((p) - (s)->pos_base) : NIL)
+#  define POS_REBASE 0x80000000UL
+#else
+#  define POS_BASE(s) 0
+#  define POS_INDEX(s, p) ((IPos)(p))
+#endif
+#define POS_STORE(s, str) ((Pos)((str) + POS_BASE(s)))
 
 /* ===========================================================================
  * Insert string str in the dictionary and set match_head to the previous head
@@ -175,14 +330,45 @@ local const config configuration_table[10] = {
  */
 #ifdef FASTEST
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
-    match_head = s->head[s->ins_h], \
-    s->head[s->ins_h] = (Pos)(str))
+   (HASH_STRING(s, str), \
+    match_head = POS_INDEX(s, s->head[s->ins_h]), \
+    s->head[s->ins_h] = POS_STORE(s, str))
 #else
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
-    match_head = s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
-    s->head[s->ins_h] = (Pos)(str))
+   (HASH_STRING(s, str), \
+    match_head = POS_INDEX(s, s->head[s->ins_h]), \
+    s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
+    s->head[s->ins_h] = POS_STORE(s, str))
+#endif
+
+/* ===========================================================================
+ * Hash functions for deflateSetHash(). The four bytes are assembled one at a
+ * time so that the hash keys, and so the compressed data, do not depend on
+ * the byte order of the machine. Compilers reduce this to a single load where
+ * they can.
+ */
+#define READ4(p) ((ulg)(p)[0] | ((ulg)(p)[1] << 8) | \
+                  ((ulg)(p)[2] << 16) | ((ulg)(p)[3] << 24))
+
+local uInt hash_multiply(s, str)
+    deflate_state *s;
+    uInt str;
+{
+    ulg val = READ4(s->window + str);
+
+    return (uInt)(((val * 2654435761UL) & 0xffffffffUL) >>
+                  (32 - s->hash_bits));
+}
+
+#ifdef X86_CPU
+Z_TARGET("sse4.2")
+local uInt hash_crc32c(s, str)
+    deflate_state *s;
+    uInt str;
+{
+    return (uInt)_mm_crc32_u32(0, (unsigned)READ4(s->window + str)) &
+           s->hash_mask;
+}
 #endif
 
 /* ===========================================================================
@@ -193,17 +379,105 @@ local const config configuration_table[10] = {
     s->head[s->hash_size-1] = NIL; \
     zmemzero((Bytef *)s->head, (unsigned)(s->hash_size-1)*sizeof(*s->head));
 
+#ifndef POS32
+/* ===========================================================================
+ * Subtract wsize from the entries of the Pos table, setting those that would
+ * go below zero to NIL. The vectorized versions use saturating subtracts on
+ * the 16-bit entries, and require that entries be a multiple of 16, which it
+ * is for head[], prev[], and tree[]. These are the slide_table kernels in
+ * z_kernels.
+ */
+void ZLIB_INTERNAL slide_table_c(table, entries, wsize)
+    voidpf table;
+    unsigned entries;
+    uInt wsize;
+{
+    unsigned m;
+    Posf *p = (Posf *)table + entries;
+
+    do {
+        m = *--p;
+        *p = (Pos)(m >= wsize ? m - wsize : NIL);
+        /* If p is in prev[] and is not on any hash chain, the entry is
+         * garbage but its value will never be used.
+         */
+    } while (--entries);
+}
+
+#ifdef X86_CPU
+Z_TARGET("sse2")
+void ZLIB_INTERNAL slide_table_sse2(table, entries, wsize)
+    voidpf table;
+    unsigned entries;
+    uInt wsize;
+{
+    __m128i w = _mm_set1_epi16((short)wsize);
+    __m128i *p = (__m128i *)table;
+
+    do {
+        _mm_storeu_si128(p, _mm_subs_epu16(_mm_loadu_si128(p), w));
+        p++;
+        entries -= 8;
+    } while (entries);
+}
+
+Z_TARGET("avx2")
+void ZLIB_INTERNAL slide_table_avx2(table, entries, wsize)
+    voidpf table;
+    unsigned entries;
+    uInt wsize;
+{
+    __m256i w = _mm256_set1_epi16((short)wsize);
+    __m256i *p = (__m256i *)table;
+
+    do {
+        _mm256_storeu_si256(p, _mm256_subs_epu16(_mm256_loadu_si256(p), w));
+        p++;
+        entries -= 16;
+    } while (entries);
+}
+#endif /* X86_CPU */
+
+#ifdef ARM_NEON
+void ZLIB_INTERNAL slide_table_neon(table, entries, wsize)
+    voidpf table;
+    unsigned entries;
+    uInt wsize;
+{
+    uint16x8_t w = vdupq_n_u16((uint16_t)wsize);
+    uint16_t *p = (uint16_t *)table;
+
+    do {
+        vst1q_u16(p, vqsubq_u16(vld1q_u16(p), w));
+        vst1q_u16(p + 8, vqsubq_u16(vld1q_u16(p + 8), w));
+        p += 16;
+        entries -= 16;
+    } while (entries);
+}
+#endif /* ARM_NEON */
+#endif /* !POS32 */
+
 /* ===========================================================================
- * Slide the hash table when sliding the window down (could be avoided with 32
- * bit values at the expense of memory usage). We slide even when level == 0 to
- * keep the hash table consistent if we switch back to level > 0 later.
+ * Slide the hash table when sliding the window down (avoided with -DPOS32 at
+ * the expense of memory usage). We slide even when level == 0 to keep the
+ * hash table consistent if we switch back to level > 0 later.
  */
 local void slide_hash(s)
     deflate_state *s;
 {
-    unsigned n, m;
+#ifdef POS32
+    ulg n, m;
     Posf *p;
-    uInt wsize = s->w_size;
+    ulg wsize;
+
+    /* Just move the base, until it gets large enough that the entries could
+     * overflow. Then subtract it from all of the entries at once.
+     */
+    s->pos_base += s->w_size;
+    if (s->pos_base < POS_REBASE)
+        return;
+    wsize = s->pos_base;
+    s->pos_base = 0;
 
     n = s->hash_size;
     p = &s->head[n];
@@ -211,8 +485,8 @@ local void slide_hash(s)
         m = *--p;
         *p = (Pos)(m >= wsize ? m - wsize : NIL);
     } while (--n);
-    n = wsize;
 #ifndef FASTEST
+    n = s->w_size;
     p = &s->prev[n];
     do {
         m = *--p;
@@ -221,7 +495,23 @@ local void slide_hash(s)
          * its value will never be used.
          */
     } while (--n);
+    if (s->tree != Z_NULL) {
+        n = 2 * s->w_size;
+        p = &s->tree[n];
+        do {
+            m = *--p;
+            *p = (Pos)(m >= wsize ? m - wsize : NIL);
+        } while (--n);
+    }
+#endif
+#else /* !POS32 */
+    z_kernels.slide_table(s->head, s->hash_size, s->w_size);
+#ifndef FASTEST
+    z_kernels.slide_table(s->prev, s->w_size, s->w_size);
+    if (s->tree != Z_NULL)
+        z_kernels.slide_table(s->tree, 2 * s->w_size, s->w_size);
 #endif
+#endif /* POS32 */
 }
 
 /* ========================================================================= */
@@ -252,11 +542,6 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
     int wrap = 1;
     static const char my_version[] = ZLIB_VERSION;
 
-    ushf *overlay;
-    /* We overlay pending_buf and d_buf+l_buf. This works since the average
-     * output size for (length,distance) codes is <= 24 bits.
-     */
-
     if (version == Z_NULL || version[0] != my_version[0] ||
         stream_size != sizeof(z_stream)) {
         return Z_VERSION_ERROR;
@@ -296,7 +581,7 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
     }
 #endif
     if (memLevel < 1 || memLevel > MAX_MEM_LEVEL || method != Z_DEFLATED ||
-        windowBits < 8 || windowBits > 15 || level < 0 || level > 9 ||
+        windowBits < 8 || windowBits > 15 || level < 0 || level > MAX_LEVEL ||
         strategy < 0 || strategy > Z_FIXED || (windowBits == 8 && wrap != 1)) {
         return Z_STREAM_ERROR;
     }
@@ -317,8 +602,18 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
     s->hash_size = 1 << s->hash_bits;
     s->hash_mask = s->hash_size - 1;
     s->hash_shift =  ((s->hash_bits+MIN_MATCH-1)/MIN_MATCH);
-
-    s->window = (Bytef *) ZALLOC(strm, s->w_size, 2*sizeof(Byte));
+    s->hash_calc = Z_NULL;
+    s->opt = Z_NULL;
+    s->opt_match = Z_NULL;
+    s->opt_cost = Z_NULL;
+    s->tree = Z_NULL;
+    s->match_method = Z_MATCH_DEFAULT;
+
+    /* two bytes more for the four-byte hashes of deflateSetHash(), which
+     * read one byte past the last string of three at the end of the window
+     */
+    s->window = (Bytef *) ZALLOC(strm, s->w_size + 1, 2*sizeof(Byte));
+    s->window_buf = Z_NULL;
     s->prev   = (Posf *)  ZALLOC(strm, s->w_size, sizeof(Pos));
     s->head   = (Posf *)  ZALLOC(strm, s->hash_size, sizeof(Pos));
 
@@ -326,9 +621,20 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
 
     s->lit_bufsize = 1 << (memLevel + 6); /* 16K elements by default */
 
-    overlay = (ushf *) ZALLOC(strm, s->lit_bufsize, sizeof(ush)+2);
-    s->pending_buf = (uchf *) overlay;
-    s->pending_buf_size = (ulg)s->lit_bufsize * (sizeof(ush)+2L);
+    /* We overlay pending_buf and sym_buf, which takes up the last three
+     * quarters of it. compress_block() writes the output for the symbols
+     * behind them as it reads them, starting lit_bufsize bytes back, and
+     * gains 24 bits of room for each three-byte symbol read. With the fixed
+     * codes a symbol takes at most 31 bits, a length code of 8 bits plus 5
+     * extra and a distance code of 5 bits plus 13 extra, so the output falls
+     * behind by at most 7 bits per symbol, and there are fewer than
+     * lit_bufsize symbols. Dynamic codes are used only when the whole block
+     * is no larger with them, and only rare symbols get long codes. Debug
+     * builds check this in compress_block(). A stored block is written only
+     * in place of reading the symbols.
+     */
+    s->pending_buf = (uchf *) ZALLOC(strm, s->lit_bufsize, 4);
+    s->pending_buf_size = (ulg)s->lit_bufsize * 4;
 
     if (s->window == Z_NULL || s->prev == Z_NULL || s->head == Z_NULL ||
         s->pending_buf == Z_NULL) {
@@ -337,10 +643,24 @@ int ZEXPORT deflateInit2_(strm, level, method, windowBits, memLevel, strategy,
         deflateEnd (strm);
         return Z_MEM_ERROR;
     }
-    s->d_buf = overlay + s->lit_bufsize/sizeof(ush);
-    s->l_buf = s->pending_buf + (1+sizeof(ush))*s->lit_bufsize;
+    s->window[2*s->w_size] = s->window[2*s->w_size + 1] = 0;
+    s->sym_buf = s->pending_buf + s->lit_bufsize;
+    s->sym_end = (s->lit_bufsize - 1) * 3;
+    /* We avoid equality with lit_bufsize*3 because of wraparound at 64K
+     * on 16 bit machines and because stored blocks are restricted to
+     * 64K-1 bytes.
+     */
+
+    if ((level > 9 && opt_alloc(strm) != Z_OK) ||
+        (USE_TREE(s->match_method, level) && tree_alloc(strm) != Z_OK)) {
+        s->status = FINISH_STATE;
+        strm->msg = ERR_MSG(Z_MEM_ERROR);
+        deflateEnd (strm);
+        return Z_MEM_ERROR;
+    }
 
     s->level = level;
+    s->use_tree = USE_TREE(s->match_method, level);
     s->strategy = strategy;
     s->method = (Byte)method;
 
@@ -418,11 +738,18 @@ int ZEXPORT deflateSetDictionary (strm, dictionary, dictLength)
         str = s->strstart;
         n = s->lookahead - (MIN_MATCH-1);
         do {
-            UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
 #ifndef FASTEST
-            s->prev[str & s->w_mask] = s->head[s->ins_h];
+            if (s->use_tree)
+                tree_matches(s, str, s->strstart + s->lookahead - str, Z_NULL);
+            else
+#endif
+            {
+                HASH_STRING(s, str);
+#ifndef FASTEST
+                s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
-            s->head[s->ins_h] = (Pos)str;
+                s->head[s->ins_h] = POS_STORE(s, str);
+            }
             str++;
         } while (--n);
         s->strstart = str;
@@ -531,10 +858,11 @@ int ZEXPORT deflatePending (strm, pending, bits)
     z_streamp strm;
 {
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    /* bi_buf can hold whole bytes that have not been moved to pending_buf */
     if (pending != Z_NULL)
-        *pending = strm->state->pending;
+        *pending = strm->state->pending + (strm->state->bi_valid >> 3);
     if (bits != Z_NULL)
-        *bits = strm->state->bi_valid;
+        *bits = strm->state->bi_valid & 7;
     return Z_OK;
 }
 
@@ -549,13 +877,13 @@ int ZEXPORT deflatePrime (strm, bits, value)
 
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
     s = strm->state;
-    if ((Bytef *)(s->d_buf) < s->pending_out + ((Buf_size + 7) >> 3))
+    if (s->sym_buf < s->pending_out + ((Buf_size + 7) >> 3))
         return Z_BUF_ERROR;
     do {
         put = Buf_size - s->bi_valid;
         if (put > bits)
             put = bits;
-        s->bi_buf |= (ush)((value & ((1 << put) - 1)) << s->bi_valid);
+        s->bi_buf |= (BitBuf)(value & ((1 << put) - 1)) << s->bi_valid;
         s->bi_valid += put;
         _tr_flush_bits(s);
         value >>= put;
@@ -581,12 +909,16 @@ int ZEXPORT deflateParams(strm, level, strategy)
 #else
     if (level == Z_DEFAULT_COMPRESSION) level = 6;
 #endif
-    if (level < 0 || level > 9 || strategy < 0 || strategy > Z_FIXED) {
+    if (level < 0 || level > MAX_LEVEL || strategy < 0 || strategy > Z_FIXED) {
         return Z_STREAM_ERROR;
     }
+    if ((level > 9 && opt_alloc(strm) != Z_OK) ||
+        (USE_TREE(s->match_method, level) && tree_alloc(strm) != Z_OK))
+        return Z_MEM_ERROR;
     func = configuration_table[s->level].func;
 
-    if ((strategy != s->strategy || func != configuration_table[level].func) &&
+    if ((strategy != s->strategy || func != configuration_table[level].func ||
+         USE_QUICK(s->level, s->strategy) != USE_QUICK(level, strategy)) &&
         s->high_water) {
         /* Flush the last buffer: */
         int err = deflate(strm, Z_BLOCK);
@@ -603,6 +935,11 @@ int ZEXPORT deflateParams(strm, level, strategy)
                 CLEAR_HASH(s);
             s->matches = 0;
         }
+        if (s->use_tree != USE_TREE(s->match_method, level)) {
+            /* the hash chains and the trees do not go together */
+            CLEAR_HASH(s);
+            s->use_tree = !s->use_tree;
+        }
         s->level = level;
         s->max_lazy_match   = configuration_table[level].max_lazy;
         s->good_match       = configuration_table[level].good_length;
@@ -613,6 +950,101 @@ int ZEXPORT deflateParams(strm, level, strategy)
     return Z_OK;
 }
 
+/* ========================================================================= */
+int ZEXPORT deflateSetHash(strm, method)
+    z_streamp strm;
+    int method;
+{
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->strstart || s->lookahead || s->insert)
+        return Z_STREAM_ERROR;          /* strings already hashed */
+    switch (method) {
+    case Z_HASH_DEFAULT:
+        s->hash_calc = Z_NULL;
+        return Z_OK;
+    case Z_HASH_CRC32C:
+#ifdef X86_CPU
+        z_cpu_check_features();
+        if (cpu_has(CPU_SSE42)) {
+            s->hash_calc = hash_crc32c;
+            break;
+        }
+#endif
+        /* fall through */
+    case Z_HASH_MULTIPLY:
+        s->hash_calc = hash_multiply;
+        break;
+    default:
+        return Z_STREAM_ERROR;
+    }
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateSetMatch(strm, method)
+    z_streamp strm;
+    int method;
+{
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->strstart || s->lookahead || s->insert)
+        return Z_STREAM_ERROR;          /* strings already inserted */
+    if (method != Z_MATCH_DEFAULT && method != Z_MATCH_CHAIN &&
+        method != Z_MATCH_TREE)
+        return Z_STREAM_ERROR;
+    if (USE_TREE(method, s->level) && tree_alloc(strm) != Z_OK)
+        return Z_MEM_ERROR;
+    s->match_method = method;
+    s->use_tree = USE_TREE(method, s->level);
+    return Z_OK;
+}
+
+/* =========================================================================
+ * Allocate the links of the tree match finder, if that has not already been
+ * done. They are kept until deflateEnd().
+ */
+local int tree_alloc(strm)
+    z_streamp strm;
+{
+    deflate_state *s = strm->state;
+
+    if (s->tree == Z_NULL) {
+        s->tree = (Posf *) ZALLOC(strm, s->w_size, 2 * sizeof(Pos));
+        if (s->tree == Z_NULL)
+            return Z_MEM_ERROR;
+    }
+    return Z_OK;
+}
+
+/* =========================================================================
+ * Allocate the buffers for the optimal parsing of level 10, if that
+ * has not already been done. They are kept until deflateEnd().
+ */
+local int opt_alloc(strm)
+    z_streamp strm;
+{
+    deflate_state *s = strm->state;
+
+    if (s->opt == Z_NULL) {
+        s->opt = (opt_node FAR *) ZALLOC(strm, OPT_NODES, sizeof(opt_node));
+        if (s->opt == Z_NULL)
+            return Z_MEM_ERROR;
+    }
+    if (s->opt_match == Z_NULL) {
+        s->opt_match = (ushf *) ZALLOC(strm, OPT_MATCH_SIZE, sizeof(ush));
+        if (s->opt_match == Z_NULL)
+            return Z_MEM_ERROR;
+        s->opt_cost = s->opt_match + 2 * OPT_PAIRS;
+        s->opt_cost[0] = 0;
+    }
+    return Z_OK;
+}
+
 /* ========================================================================= */
 int ZEXPORT deflateTune(strm, good_length, max_lazy, nice_length, max_chain)
     z_streamp strm;
@@ -858,7 +1290,7 @@ int ZEXPORT deflate (strm, flush)
             put_byte(s, 0);
             put_byte(s, 0);
             put_byte(s, 0);
-            put_byte(s, s->level == 9 ? 2 :
+            put_byte(s, s->level >= 9 ? 2 :
                      (s->strategy >= Z_HUFFMAN_ONLY || s->level < 2 ?
                       4 : 0));
             put_byte(s, OS_CODE);
@@ -882,7 +1314,7 @@ int ZEXPORT deflate (strm, flush)
             put_byte(s, (Byte)((s->gzhead->time >> 8) & 0xff));
             put_byte(s, (Byte)((s->gzhead->time >> 16) & 0xff));
             put_byte(s, (Byte)((s->gzhead->time >> 24) & 0xff));
-            put_byte(s, s->level == 9 ? 2 :
+            put_byte(s, s->level >= 9 ? 2 :
                      (s->strategy >= Z_HUFFMAN_ONLY || s->level < 2 ?
                       4 : 0));
             put_byte(s, s->gzhead->os & 0xff);
@@ -997,10 +1429,28 @@ int ZEXPORT deflate (strm, flush)
         (flush != Z_NO_FLUSH && s->status != FINISH_STATE)) {
         block_state bstate;
 
+        /* If this is all of the input for the stream and more than a
+         * window's worth of it, then compress it in place instead of copying
+         * it into the window.  fill_window() moves window along the input, and
+         * window_own() goes back to the allocated window when the input left
+         * will no longer run past it, which the four-byte hashes can read.
+         */
+        if (flush == Z_FINISH && s->level != 0 && s->strstart == 0 &&
+            s->lookahead == 0 && s->insert == 0 &&
+            strm->avail_in > s->window_size) {
+            s->window_buf = s->window;
+            s->window = (Bytef *)strm->next_in;
+        }
+
         bstate = s->level == 0 ? deflate_stored(s, flush) :
                  s->strategy == Z_HUFFMAN_ONLY ? deflate_huff(s, flush) :
                  s->strategy == Z_RLE ? deflate_rle(s, flush) :
+#ifndef FASTEST
+                 USE_QUICK(s->level, s->strategy) ? deflate_quick(s, flush) :
+#endif
                  (*(configuration_table[s->level].func))(s, flush);
+        if (s->window_buf != Z_NULL)
+            window_own(s);
 
         if (bstate == finish_started || bstate == finish_done) {
             s->status = FINISH_STATE;
@@ -1083,6 +1533,9 @@ int ZEXPORT deflateEnd (strm)
     status = strm->state->status;
 
     /* Deallocate in reverse order of allocations: */
+    TRY_FREE(strm, strm->state->tree);
+    TRY_FREE(strm, strm->state->opt_match);
+    TRY_FREE(strm, strm->state->opt);
     TRY_FREE(strm, strm->state->pending_buf);
     TRY_FREE(strm, strm->state->head);
     TRY_FREE(strm, strm->state->prev);
@@ -1108,7 +1561,6 @@ int ZEXPORT deflateCopy (dest, source)
 #else
     deflate_state *ds;
     deflate_state *ss;
-    ushf *overlay;
 
 
     if (deflateStateCheck(source) || dest == Z_NULL) {
@@ -1125,26 +1577,40 @@ int ZEXPORT deflateCopy (dest, source)
     zmemcpy((voidpf)ds, (voidpf)ss, sizeof(deflate_state));
     ds->strm = dest;
 
-    ds->window = (Bytef *) ZALLOC(dest, ds->w_size, 2*sizeof(Byte));
+    ds->window = (Bytef *) ZALLOC(dest, ds->w_size + 1, 2*sizeof(Byte));
     ds->prev   = (Posf *)  ZALLOC(dest, ds->w_size, sizeof(Pos));
     ds->head   = (Posf *)  ZALLOC(dest, ds->hash_size, sizeof(Pos));
-    overlay = (ushf *) ZALLOC(dest, ds->lit_bufsize, sizeof(ush)+2);
-    ds->pending_buf = (uchf *) overlay;
+    ds->pending_buf = (uchf *) ZALLOC(dest, ds->lit_bufsize, 4);
+    ds->opt = Z_NULL;
+    ds->opt_match = Z_NULL;
+    ds->opt_cost = Z_NULL;
+    ds->tree = Z_NULL;
 
     if (ds->window == Z_NULL || ds->prev == Z_NULL || ds->head == Z_NULL ||
-        ds->pending_buf == Z_NULL) {
+        ds->pending_buf == Z_NULL ||
+        (ss->opt != Z_NULL && opt_alloc(dest) != Z_OK) ||
+        (ss->tree != Z_NULL && tree_alloc(dest) != Z_OK)) {
         deflateEnd (dest);
         return Z_MEM_ERROR;
     }
     /* following zmemcpy do not work for 16-bit MSDOS */
-    zmemcpy(ds->window, ss->window, ds->w_size * 2 * sizeof(Byte));
+    zmemcpy(ds->window, ss->window, (ds->w_size + 1) * 2 * sizeof(Byte));
     zmemcpy((voidpf)ds->prev, (voidpf)ss->prev, ds->w_size * sizeof(Pos));
     zmemcpy((voidpf)ds->head, (voidpf)ss->head, ds->hash_size * sizeof(Pos));
     zmemcpy(ds->pending_buf, ss->pending_buf, (uInt)ds->pending_buf_size);
+    if (ss->opt != Z_NULL) {
+        zmemcpy((voidpf)ds->opt, (voidpf)ss->opt,
+                OPT_NODES * sizeof(opt_node));
+        zmemcpy((voidpf)ds->opt_match, (voidpf)ss->opt_match,
+                OPT_MATCH_SIZE * sizeof(ush));
+        ds->opt_cost = ds->opt_match + 2 * OPT_PAIRS;
+    }
+    if (ss->tree != Z_NULL)
+        zmemcpy((voidpf)ds->tree, (voidpf)ss->tree,
+                2 * ds->w_size * sizeof(Pos));
 
     ds->pending_out = ds->pending_buf + (ss->pending_out - ss->pending_buf);
-    ds->d_buf = overlay + ds->lit_bufsize/sizeof(ush);
-    ds->l_buf = ds->pending_buf + (1+sizeof(ush))*ds->lit_bufsize;
+    ds->sym_buf = ds->pending_buf + ds->lit_bufsize;
 
     ds->l_desc.dyn_tree = ds->dyn_ltree;
     ds->d_desc.dyn_tree = ds->dyn_dtree;
@@ -1154,6 +1620,206 @@ int ZEXPORT deflateCopy (dest, source)
 #endif /* MAXSEG_64K */
 }
 
+/* ===========================================================================
+ * Write the low n bytes of val at next, and return the byte after them.
+ */
+local Bytef *putsaved(next, val, n)
+    Bytef *next;
+    ulg val;
+    int n;
+{
+    while (n--) {
+        *next++ = (Bytef)val;
+        val >>= 8;
+    }
+    return next;
+}
+
+/* ===========================================================================
+ * Read n bytes at *next as a value, and advance *next past them.
+ */
+local ulg getsaved(next, n)
+    const Bytef **next;
+    int n;
+{
+    ulg val;
+    int k;
+
+    *next += n;
+    val = 0;
+    for (k = 1; k <= n; k++)
+        val = (val << 8) + (*next)[-k];
+    return val;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateSave (strm, buf, len)
+    z_streamp strm;
+    Bytef *buf;
+    uInt *len;
+{
+    deflate_state *s;
+    Bytef *next;
+    uInt have;
+    BitBuf bits;
+    int hash, k;
+
+    /* check that the stream is at a flush point, with nothing held back */
+    if (deflateStateCheck(strm) || len == Z_NULL)
+        return Z_STREAM_ERROR;
+    s = strm->state;
+    if ((s->status != INIT_STATE &&
+#ifdef GZIP
+         s->status != GZIP_STATE &&
+#endif
+         s->status != BUSY_STATE && s->status != FINISH_STATE) ||
+        s->lookahead || s->sym_next || s->match_available || s->block_open ||
+        s->opt_pos != s->opt_end || s->block_start != (long)s->strstart)
+        return Z_STREAM_ERROR;
+
+    /* check room */
+    have = s->strstart < s->w_size ? s->strstart : s->w_size;
+    if (buf == Z_NULL) {
+        *len = SAVED + (uInt)s->pending + have;
+        return Z_OK;
+    }
+    if (*len < SAVED + s->pending + have)
+        return Z_BUF_ERROR;
+    *len = SAVED + (uInt)s->pending + have;
+
+    /* save state */
+    hash = s->hash_calc == Z_NULL ? Z_HASH_DEFAULT :
+           s->hash_calc == hash_multiply ? Z_HASH_MULTIPLY : Z_HASH_CRC32C;
+    next = buf;
+    next = putsaved(next, 1, 1);
+    next = putsaved(next, (ulg)s->status, 2);
+    next = putsaved(next, (ulg)(s->wrap + 2), 1);
+    next = putsaved(next, s->w_bits, 1);
+    next = putsaved(next, (ulg)s->level, 1);
+    next = putsaved(next, (ulg)s->strategy, 1);
+    next = putsaved(next, (ulg)hash, 1);
+    next = putsaved(next, (ulg)s->match_method, 1);
+    next = putsaved(next, (ulg)(s->last_flush + 1), 1);
+    next = putsaved(next, (ulg)strm->data_type, 1);
+    next = putsaved(next, (ulg)s->bi_valid, 1);
+    bits = s->bi_buf;
+    for (k = 0; k < 8; k++) {
+        *next++ = (Bytef)bits;
+        bits >>= 8;
+    }
+    next = putsaved(next, s->good_match, 4);
+    next = putsaved(next, s->max_lazy_match, 4);
+    next = putsaved(next, (ulg)s->nice_match, 4);
+    next = putsaved(next, s->max_chain_length, 4);
+    next = putsaved(next, strm->adler, 4);
+    next = putsaved(next, strm->total_in, 8);
+    next = putsaved(next, strm->total_out, 8);
+    next = putsaved(next, s->pending, 4);
+    next = putsaved(next, have, 4);
+
+    /* save pending output and history */
+    zmemcpy(next, s->pending_out, (unsigned)s->pending);
+    next += s->pending;
+    zmemcpy(next, s->window + s->strstart - have, have);
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateRestore (strm, buf, len)
+    z_streamp strm;
+    const Bytef *buf;
+    uInt len;
+{
+    deflate_state *s;
+    const Bytef *next;
+    int status, wrap, level, strategy, hash, match, last_flush, data_type;
+    int bi_valid, k;
+    uInt w_bits;
+    ulg pending, have;
+    BitBuf bits;
+
+    /* check state and the image */
+    if (deflateStateCheck(strm) || buf == Z_NULL)
+        return Z_STREAM_ERROR;
+    s = strm->state;
+    if (len < SAVED || buf[0] != 1)
+        return Z_DATA_ERROR;
+    next = buf + 1;
+    status = (int)getsaved(&next, 2);
+    wrap = (int)getsaved(&next, 1) - 2;
+    w_bits = (uInt)getsaved(&next, 1);
+    level = (int)getsaved(&next, 1);
+    strategy = (int)getsaved(&next, 1);
+    hash = (int)getsaved(&next, 1);
+    match = (int)getsaved(&next, 1);
+    last_flush = (int)getsaved(&next, 1) - 1;
+    data_type = (int)getsaved(&next, 1);
+    bi_valid = (int)getsaved(&next, 1);
+    next = buf + 56;
+    pending = getsaved(&next, 4);
+    have = getsaved(&next, 4);
+    if ((status != INIT_STATE || wrap != 1) &&
+#ifdef GZIP
+        (status != GZIP_STATE || wrap != 2) &&
+#endif
+        status != BUSY_STATE && status != FINISH_STATE)
+        return Z_DATA_ERROR;
+    if (wrap > 2 || w_bits != s->w_bits || level > MAX_LEVEL ||
+        strategy > Z_FIXED || hash > Z_HASH_CRC32C || match > Z_MATCH_TREE ||
+        last_flush > Z_TREES || data_type > Z_UNKNOWN || bi_valid > Buf_size ||
+        pending > s->pending_buf_size || have > s->w_size ||
+        len != SAVED + pending + have)
+        return Z_DATA_ERROR;
+#ifdef FASTEST
+    if (level != 0) level = 1;
+#endif
+    if ((level > 9 && opt_alloc(strm) != Z_OK) ||
+        (USE_TREE(match, level) && tree_alloc(strm) != Z_OK))
+        return Z_MEM_ERROR;
+
+    /* start over with the saved settings, and an empty hash */
+    s->wrap = wrap < 0 ? -wrap : wrap;
+    s->level = level;
+    s->strategy = strategy;
+    deflateReset(strm);
+    deflateSetMatch(strm, match);
+    deflateSetHash(strm, hash);
+
+    /* restore state, with only the valid bits of the bit buffer */
+    s->status = status;
+    s->wrap = wrap;
+    s->last_flush = last_flush;
+    strm->data_type = data_type;
+    bits = 0;
+    for (k = (bi_valid + 7) >> 3; k; k--)
+        bits = (BitBuf)(bits << 8) + buf[11 + k];
+    if (bi_valid < Buf_size)
+        bits &= ((BitBuf)1 << bi_valid) - 1;
+    s->bi_buf = bits;
+    s->bi_valid = bi_valid;
+    next = buf + 20;
+    s->good_match = (uInt)getsaved(&next, 4);
+    s->max_lazy_match = (uInt)getsaved(&next, 4);
+    s->nice_match = (int)getsaved(&next, 4);
+    s->max_chain_length = (uInt)getsaved(&next, 4);
+    strm->adler = getsaved(&next, 4);
+    strm->total_in = getsaved(&next, 8);
+    strm->total_out = getsaved(&next, 8);
+
+    /* restore pending output, and history to be hashed with the next input */
+    next = buf + SAVED;
+    zmemcpy(s->pending_buf, next, (unsigned)pending);
+    s->pending = pending;
+    next += pending;
+    zmemcpy(s->window, next, (unsigned)have);
+    s->strstart = (uInt)have;
+    s->block_start = (long)have;
+    s->insert = (uInt)have;
+    if (s->high_water < have)
+        s->high_water = have;
+    return Z_OK;
+}
+
 /* ===========================================================================
  * Read a new buffer from the current input stream, update the adler32
  * and total number of bytes read.  All deflate() input goes through
@@ -1173,7 +1839,8 @@ local unsigned read_buf(strm, buf, size)
 
     strm->avail_in  -= len;
 
-    zmemcpy(buf, strm->next_in, len);
+    if (buf != strm->next_in)       /* else the window is the input */
+        zmemcpy(buf, strm->next_in, len);
     if (strm->state->wrap == 1) {
         strm->adler = adler32(strm->adler, buf, len);
     }
@@ -1188,6 +1855,24 @@ local unsigned read_buf(strm, buf, size)
     return len;
 }
 
+/* ===========================================================================
+ * Copy the window data from the input, where a one-shot deflate() has been
+ * using it in place, to the allocated window, and use that from now on.  This
+ * is done before deflate() returns, since the input may not be there the next
+ * time it is called.
+ */
+local void window_own(s)
+    deflate_state *s;
+{
+    ulg have = s->strstart + (ulg)s->lookahead;
+
+    zmemcpy(s->window_buf, s->window, (unsigned)have);
+    s->window = s->window_buf;
+    s->window_buf = Z_NULL;
+    if (s->high_water < have)
+        s->high_water = have;
+}
+
 /* ===========================================================================
  * Initialize the "longest match" routines for a new zlib stream
  */
@@ -1197,6 +1882,9 @@ local void lm_init (s)
     s->window_size = (ulg)2L*s->w_size;
 
     CLEAR_HASH(s);
+#ifdef POS32
+    s->pos_base = 0;
+#endif
 
     /* Set the default configuration parameters:
      */
@@ -1212,13 +1900,118 @@ local void lm_init (s)
     s->match_length = s->prev_length = MIN_MATCH-1;
     s->match_available = 0;
     s->ins_h = 0;
-#ifndef FASTEST
-#ifdef ASMV
+    s->block_open = 0;
+    s->opt_pos = s->opt_end = 0;
+    if (s->opt_cost != Z_NULL)
+        s->opt_cost[0] = 0;
+    z_cpu_check_features();
+#if defined(ASMV) && !defined(FASTEST)
     match_init(); /* initialize the asm code */
 #endif
+}
+
+/* ===========================================================================
+ * Return the number of leading bytes of scan[0..255] that are equal to those
+ * of match[0..255]. This is the inner loop of longest_match(), which uses it
+ * for everything after the first two bytes of a candidate string, for a total
+ * of MAX_MATCH == 258. All 256 bytes of both strings must be readable, though
+ * not necessarily written, since the caller limits the length to lookahead.
+ * These are the compare256 kernels in z_kernels. The portable one compares
+ * eight bytes at a time where there is a 64-bit word, locating the first
+ * difference in a word by counting its trailing (or on big-endian machines,
+ * leading) zero bits.
+ */
+unsigned ZLIB_INTERNAL compare256_c(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    unsigned len = 0;
+#ifdef MATCH_WORD
+    MATCH_WORD a, b;
+
+    do {
+        zmemcpy(&a, scan + len, sizeof(a));
+        zmemcpy(&b, match + len, sizeof(b));
+        if (a != b)
+            return len + MATCH_DIFF(a ^ b);
+        len += sizeof(a);
+    } while (len < 256);
+    return 256;
+#else
+    do {
+        if (scan[len] != match[len]) break;
+        len++;
+        if (scan[len] != match[len]) break;
+        len++;
+        if (scan[len] != match[len]) break;
+        len++;
+        if (scan[len] != match[len]) break;
+        len++;
+        if (scan[len] != match[len]) break;
+        len++;
+        if (scan[len] != match[len]) break;
+        len++;
+        if (scan[len] != match[len]) break;
+        len++;
+        if (scan[len] != match[len]) break;
+        len++;
+    } while (len < 256);
+    return len;
+#endif
+}
+
+#ifdef X86_CPU
+#ifdef _MSC_VER
+/* Return the position of the least significant one bit in x != 0. */
+local unsigned first_one(x)
+    unsigned x;
+{
+    unsigned long n;
+
+    _BitScanForward(&n, x);
+    return (unsigned)n;
+}
 #endif
+
+/* Compare 16 bytes at a time, getting a bit for each equal byte. */
+Z_TARGET("sse2")
+unsigned ZLIB_INTERNAL compare256_sse2(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    unsigned len = 0, eq;
+
+    do {
+        eq = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(scan + len)),
+                _mm_loadu_si128((const __m128i *)(match + len))));
+        if (eq != 0xffff)
+            return len + FIRST_ONE(~eq);
+        len += 16;
+    } while (len < 256);
+    return 256;
 }
 
+/* Compare 32 bytes at a time, getting a bit for each equal byte. */
+Z_TARGET("avx2")
+unsigned ZLIB_INTERNAL compare256_avx2(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    unsigned len = 0, eq;
+
+    do {
+        eq = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(scan + len)),
+                _mm256_loadu_si256((const __m256i *)(match + len))));
+        if (eq != 0xffffffff)
+            return len + FIRST_ONE(~eq);
+        len += 32;
+    } while (len < 256);
+    return 256;
+}
+#endif /* X86_CPU */
+
 #ifndef FASTEST
 /* ===========================================================================
  * Set match_start to the longest match starting at the given string and
@@ -1231,7 +2024,8 @@ local void lm_init (s)
  */
 #ifndef ASMV
 /* For 80x86 and 680x0, an optimized version will be provided in match.asm or
- * match.S. The code will be functionally equivalent.
+ * match.S. The code will be functionally equivalent. Those are superseded
+ * by the compare256() kernels, which are chosen at run time.
  */
 local uInt longest_match(s, cur_match)
     deflate_state *s;
@@ -1250,24 +2044,29 @@ local uInt longest_match(s, cur_match)
      */
     Posf *prev = s->prev;
     uInt wmask = s->w_mask;
+    IPos base = POS_BASE(s);
+    IPos next;                                  /* next match on the chain */
+    /* cur_match and limit are kept as values stored in prev[], so that the
+     * chain can be followed without converting each link to an index. Since
+     * base is a multiple of the window size, cur_match & wmask is the same
+     * for both. Links that have slid out of the window are <= limit.
+     */
 
 #ifdef UNALIGNED_OK
     /* Compare two bytes at a time. Note: this is not always beneficial.
      * Try with and without -DUNALIGNED_OK to check.
      */
-    register Bytef *strend = s->window + s->strstart + MAX_MATCH - 1;
     register ush scan_start = *(ushf*)scan;
     register ush scan_end   = *(ushf*)(scan+best_len-1);
 #else
-    register Bytef *strend = s->window + s->strstart + MAX_MATCH;
     register Byte scan_end1  = scan[best_len-1];
     register Byte scan_end   = scan[best_len];
 #endif
 
-    /* The code is optimized for HASH_BITS >= 8 and MAX_MATCH-2 multiple of 16.
+    /* The code is optimized for MAX_MATCH-2 a multiple of 32.
      * It is easy to get rid of this optimization if necessary.
      */
-    Assert(s->hash_bits >= 8 && MAX_MATCH == 258, "Code too clever");
+    Assert(MAX_MATCH == 258, "Code too clever");
 
     /* Do not waste too much time if we already have a good match: */
     if (s->prev_length >= s->good_match) {
@@ -1280,9 +2079,21 @@ local uInt longest_match(s, cur_match)
 
     Assert((ulg)s->strstart <= s->window_size-MIN_LOOKAHEAD, "need lookahead");
 
+    cur_match += base;
+    limit += base;
     do {
-        Assert(cur_match < s->strstart, "no future");
-        match = s->window + cur_match;
+        Assert(cur_match - base < s->strstart, "no future");
+        match = s->window + (cur_match - base);
+
+        /* Start loading the link and the string for the next match now, so
+         * that the cache misses on them, when the window and prev[] do not
+         * stay in the cache, are not waited for one after the other.
+         */
+        next = prev[cur_match & wmask];
+        if (next > limit) {
+            PREFETCH(prev + (next & wmask));
+            PREFETCH(s->window + (next - base) + best_len - 1);
+        }
 
         /* Skip to next match if the match length cannot increase
          * or if the match length is less than 2.  Note that the checks below
@@ -1292,74 +2103,30 @@ local uInt longest_match(s, cur_match)
          * However the length of the match is limited to the lookahead, so
          * the output of deflate is not affected by the uninitialized values.
          */
-#if (defined(UNALIGNED_OK) && MAX_MATCH == 258)
+#ifdef UNALIGNED_OK
         /* This code assumes sizeof(unsigned short) == 2. Do not use
          * UNALIGNED_OK if your compiler uses a different size.
          */
         if (*(ushf*)(match+best_len-1) != scan_end ||
             *(ushf*)match != scan_start) continue;
+#else
+        if (match[best_len]   != scan_end  ||
+            match[best_len-1] != scan_end1 ||
+            match[0]          != scan[0]   ||
+            match[1]          != scan[1])      continue;
+#endif
 
-        /* It is not necessary to compare scan[2] and match[2] since they are
-         * always equal when the other bytes match, given that the hash keys
-         * are equal and that HASH_BITS >= 8. Compare 2 bytes at a time at
-         * strstart+3, +5, ... up to strstart+257. We check for insufficient
-         * lookahead only every 4th comparison; the 128th check will be made
-         * at strstart+257. If MAX_MATCH-2 is not a multiple of 8, it is
-         * necessary to put more guard bytes at the end of the window, or
-         * to check more often for insufficient lookahead.
+        /* The check at best_len-1 can be removed because it will be made
+         * again later. (This heuristic is not always a win.) scan[2] and
+         * match[2] are compared even though the hash keys usually make them
+         * equal, since that need not hold for every hash function.
          */
-        Assert(scan[2] == match[2], "scan[2]?");
-        scan++, match++;
-        do {
-        } while (*(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 *(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 *(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 *(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 scan < strend);
-        /* The funny "do {}" generates better code on most compilers */
-
-        /* Here, scan <= window+strstart+257 */
-        Assert(scan <= s->window+(unsigned)(s->window_size-1), "wild scan");
-        if (*scan == *match) scan++;
-
-        len = (MAX_MATCH - 1) - (int)(strend-scan);
-        scan = strend - (MAX_MATCH-1);
-
-#else /* UNALIGNED_OK */
-
-        if (match[best_len]   != scan_end  ||
-            match[best_len-1] != scan_end1 ||
-            *match            != *scan     ||
-            *++match          != scan[1])      continue;
-
-        /* The check at best_len-1 can be removed because it will be made
-         * again later. (This heuristic is not always a win.)
-         * It is not necessary to compare scan[2] and match[2] since they
-         * are always equal when the other bytes match, given that
-         * the hash keys are equal and that HASH_BITS >= 8.
-         */
-        scan += 2, match++;
-        Assert(*scan == *match, "match[2]?");
-
-        /* We check for insufficient lookahead only every 8th comparison;
-         * the 256th check will be made at strstart+258.
-         */
-        do {
-        } while (*++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 scan < strend);
-
-        Assert(scan <= s->window+(unsigned)(s->window_size-1), "wild scan");
-
-        len = MAX_MATCH - (int)(strend - scan);
-        scan = strend - MAX_MATCH;
-
-#endif /* UNALIGNED_OK */
+        len = 2 + (int)z_kernels.compare256(scan + 2, match + 2);
+        Assert(scan + len <= s->window+(unsigned)(s->window_size-1),
+               "wild scan");
 
         if (len > best_len) {
-            s->match_start = cur_match;
+            s->match_start = cur_match - base;
             best_len = len;
             if (len >= nice_match) break;
 #ifdef UNALIGNED_OK
@@ -1369,14 +2136,136 @@ local uInt longest_match(s, cur_match)
             scan_end   = scan[best_len];
 #endif
         }
-    } while ((cur_match = prev[cur_match & wmask]) > limit
-             && --chain_length != 0);
+    } while ((cur_match = next) > limit && --chain_length != 0);
 
     if ((uInt)best_len <= s->lookahead) return (uInt)best_len;
     return s->lookahead;
 }
 #endif /* ASMV */
 
+/* ===========================================================================
+ * Insert the string at str in the binary tree of the strings with the same
+ * hash index, as its new root, and find the matches for it on the way. The
+ * strings in each tree are kept in order, so the path down from the root
+ * passes the strings that share the most leading bytes with str, and is
+ * where the tree is split into the strings less than str and those greater
+ * than it, which become the two subtrees of str. That visits about log2 of
+ * the strings in the tree, instead of all of them as for a hash chain. No
+ * more than max_chain_length strings are visited. Those beyond that or past
+ * MAX_DIST are cut off from the tree.
+ *
+ * If pairs is not Z_NULL, put there the lengths and distances of the matches
+ * found, each longer than the one before, and return how many there are, as
+ * for opt_matches(). The strings compared are at most most bytes long, and
+ * the search stops at a match of nice_match or more, which then takes the
+ * place of the matched string in the tree. If pairs is Z_NULL, the string is
+ * only inserted, as for the strings covered by a match, and nothing is
+ * checked that is only needed to report matches.
+ * IN assertion: as for INSERT_STRING, and most >= MIN_MATCH
+ */
+local uInt tree_matches(s, str, most, pairs)
+    deflate_state *s;
+    IPos str;                                   /* current string */
+    uInt most;                                  /* bytes available at str */
+    ushf *pairs;                                /* lengths and distances */
+{
+    Posf *tree = s->tree;
+    Posf *less = tree + 2 * (str & s->w_mask);  /* link to next lesser */
+    Posf *more = less + 1;                      /* link to next greater */
+    unsigned depth = s->max_chain_length;       /* strings left to visit */
+    Bytef *scan = s->window + str;
+    Bytef *match;
+    uInt len;
+    uInt len_less = 0, len_more = 0;    /* bytes shared with str by the last
+                                           lesser and greater strings */
+    uInt best_len = MIN_MATCH-1;                /* best match length so far */
+    uInt nice = (uInt)s->nice_match;            /* stop if match long enough */
+    uInt found = 0;                             /* pairs found */
+    IPos limit = str > (IPos)MAX_DIST(s) ? str - (IPos)MAX_DIST(s) : NIL;
+    IPos base = POS_BASE(s);
+    IPos cur_match;                             /* current match, as stored */
+    uInt wmask = s->w_mask;
+
+    if (most > MAX_MATCH)
+        most = MAX_MATCH;
+    if (nice > most)
+        nice = most;
+    HASH_STRING(s, str);
+    cur_match = s->head[s->ins_h];
+    s->head[s->ins_h] = POS_STORE(s, str);
+
+    limit += base;
+    for (;;) {
+        if (cur_match <= limit || depth-- == 0) {
+            *less = *more = NIL;
+            break;
+        }
+        Assert(cur_match - base < str, "no future");
+        match = s->window + (cur_match - base);
+        PREFETCH(tree + 2 * ((cur_match - base) & wmask));
+
+        /* Every string below a lesser and a greater string in the tree lies
+         * between them, and so shares with str at least as many leading
+         * bytes as the one of them that shares fewer. The compare starts
+         * after those. compare256() is used when it can read 256 bytes
+         * within the window, which past the lookahead are bytes that
+         * fill_window() has initialized, and the length is cut to most
+         * after. The last bytes of a long match are compared one at a time.
+         */
+        len = len_less < len_more ? len_less : len_more;
+        if (str + len + 256 <= s->window_size)
+            len += z_kernels.compare256(scan + len, match + len);
+        while (len < most && scan[len] == match[len])
+            len++;
+        if (len > most)
+            len = most;
+        if (len > best_len && pairs != Z_NULL) {
+            /* A string that was inserted with fewer than nice_match bytes
+             * to compare, just before a flush, or whose place was taken by
+             * a match shorter than MAX_MATCH, may be out of order past the
+             * bytes that were compared. Then the bytes skipped above may
+             * differ, so check them before reporting a match. There are
+             * never more of those than best_len, and only a longer match
+             * is checked. If they differ, the rest of the search compares
+             * from the start.
+             */
+            uInt known = len_less < len_more ? len_less : len_more;
+
+            if (known && zmemcmp(scan, match, known) != 0) {
+                for (len = 0; scan[len] == match[len]; len++)
+                    ;
+                len_less = len_more = 0;
+            }
+            else {
+                pairs[0] = (ush)len;
+                pairs[1] = (ush)(str - (cur_match - base));
+                pairs += 2;
+                found++;
+                best_len = len;
+            }
+        }
+        if (len >= nice) {
+            /* take the place of the matched string */
+            *less = tree[2 * ((cur_match - base) & wmask)];
+            *more = tree[2 * ((cur_match - base) & wmask) + 1];
+            break;
+        }
+        if (match[len] < scan[len]) {
+            *less = (Pos)cur_match;
+            less = tree + 2 * ((cur_match - base) & wmask) + 1;
+            cur_match = *less;
+            len_less = len;
+        }
+        else {
+            *more = (Pos)cur_match;
+            more = tree + 2 * ((cur_match - base) & wmask);
+            cur_match = *more;
+            len_more = len;
+        }
+    }
+    return found;
+}
+
 #else /* FASTEST */
 
 /* ---------------------------------------------------------------------------
@@ -1389,12 +2278,6 @@ local uInt longest_match(s, cur_match)
     register Bytef *scan = s->window + s->strstart; /* current string */
     register Bytef *match;                       /* matched string */
     register int len;                           /* length of current match */
-    register Bytef *strend = s->window + s->strstart + MAX_MATCH;
-
-    /* The code is optimized for HASH_BITS >= 8 and MAX_MATCH-2 multiple of 16.
-     * It is easy to get rid of this optimization if necessary.
-     */
-    Assert(s->hash_bits >= 8 && MAX_MATCH == 258, "Code too clever");
 
     Assert((ulg)s->strstart <= s->window_size-MIN_LOOKAHEAD, "need lookahead");
 
@@ -1406,28 +2289,8 @@ local uInt longest_match(s, cur_match)
      */
     if (match[0] != scan[0] || match[1] != scan[1]) return MIN_MATCH-1;
 
-    /* The check at best_len-1 can be removed because it will be made
-     * again later. (This heuristic is not always a win.)
-     * It is not necessary to compare scan[2] and match[2] since they
-     * are always equal when the other bytes match, given that
-     * the hash keys are equal and that HASH_BITS >= 8.
-     */
-    scan += 2, match += 2;
-    Assert(*scan == *match, "match[2]?");
-
-    /* We check for insufficient lookahead only every 8th comparison;
-     * the 256th check will be made at strstart+258.
-     */
-    do {
-    } while (*++scan == *++match && *++scan == *++match &&
-             *++scan == *++match && *++scan == *++match &&
-             *++scan == *++match && *++scan == *++match &&
-             *++scan == *++match && *++scan == *++match &&
-             scan < strend);
-
-    Assert(scan <= s->window+(unsigned)(s->window_size-1), "wild scan");
-
-    len = MAX_MATCH - (int)(strend - scan);
+    len = 2 + (int)z_kernels.compare256(scan + 2, match + 2);
+    Assert(scan + len <= s->window+(unsigned)(s->window_size-1), "wild scan");
 
     if (len < MIN_MATCH) return MIN_MATCH - 1;
 
@@ -1509,9 +2372,20 @@ local void fill_window(s)
          */
         if (s->strstart >= wsize+MAX_DIST(s)) {
 
-            zmemcpy(s->window, s->window+wsize, (unsigned)wsize - more);
-            s->match_start -= wsize;
             s->strstart    -= wsize; /* we now have strstart >= MAX_DIST */
+            if (s->window_buf == Z_NULL)
+                zmemcpy(s->window, s->window+wsize, (unsigned)wsize - more);
+            else {
+                /* The window is the input: move it along the input if there
+                 * is enough left to run past it, else copy to the allocated
+                 * one.
+                 */
+                s->window += wsize;
+                if (s->window_size >= s->strstart + (ulg)s->lookahead +
+                                     s->strm->avail_in)
+                    window_own(s);
+            }
+            s->match_start -= wsize;
             s->block_start -= (long) wsize;
             slide_hash(s);
             more += wsize;
@@ -1523,10 +2397,8 @@ local void fill_window(s)
          *    more == window_size - lookahead - strstart
          * => more >= window_size - (MIN_LOOKAHEAD-1 + WSIZE + MAX_DIST-1)
          * => more >= window_size - 2*WSIZE + 2
-         * In the BIG_MEM or MMAP case (not yet supported),
-         *   window_size == input_size + MIN_LOOKAHEAD  &&
-         *   strstart + s->lookahead <= input_size => more >= MIN_LOOKAHEAD.
-         * Otherwise, window_size == 2*WSIZE so more >= 2.
+         * window_size == 2*WSIZE so more >= 2, also when the window is the
+         * input.
          * If there was sliding, more >= WSIZE. So in all cases, more >= 2.
          */
         Assert(more >= 2, "more < 2");
@@ -1537,17 +2409,36 @@ local void fill_window(s)
         /* Initialize the hash value now that we have some input: */
         if (s->lookahead + s->insert >= MIN_MATCH) {
             uInt str = s->strstart - s->insert;
+            ulg curr = s->strstart + (ulg)(s->lookahead);
+
+            /* The four-byte hashes read the byte after the last string of
+             * three, before it is initialized below.  Zero it if it has
+             * never been written.  Past the end of the window it is one of
+             * the two zeroed bytes allocated for this, and when the window
+             * is the input it is more input.
+             */
+            if (s->hash_calc != Z_NULL && s->window_buf == Z_NULL &&
+                s->high_water <= curr && curr < s->window_size)
+                s->window[curr] = 0;
             s->ins_h = s->window[str];
             UPDATE_HASH(s, s->ins_h, s->window[str + 1]);
 #if MIN_MATCH != 3
             Call UPDATE_HASH() MIN_MATCH-3 more times
 #endif
             while (s->insert) {
-                UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
 #ifndef FASTEST
-                s->prev[str & s->w_mask] = s->head[s->ins_h];
+                if (s->use_tree)
+                    tree_matches(s, str, s->strstart + s->lookahead - str,
+                                 Z_NULL);
+                else
+#endif
+                {
+                    HASH_STRING(s, str);
+#ifndef FASTEST
+                    s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
-                s->head[s->ins_h] = (Pos)str;
+                    s->head[s->ins_h] = POS_STORE(s, str);
+                }
                 str++;
                 s->insert--;
                 if (s->lookahead + s->insert < MIN_MATCH)
@@ -1566,8 +2457,9 @@ local void fill_window(s)
      * the longest match routines.  Update the high water mark for the next
      * time through here.  WIN_INIT is set to MAX_MATCH since the longest match
      * routines allow scanning to strstart + MAX_MATCH, ignoring lookahead.
+     * When the window is the input, those bytes are input data.
      */
-    if (s->high_water < s->window_size) {
+    if (s->window_buf == Z_NULL && s->high_water < s->window_size) {
         ulg curr = s->strstart + (ulg)(s->lookahead);
         ulg init;
 
@@ -1912,7 +2804,7 @@ local block_state deflate_fast(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
@@ -1929,6 +2821,8 @@ local block_state deflate_slow(s, flush)
 {
     IPos hash_head;          /* head of hash chain */
     int bflush;              /* set if current block must be flushed */
+    ush pairs[2*(MAX_MATCH-MIN_MATCH+1)];   /* matches found by the tree */
+    uInt found;              /* number of pairs */
 
     /* Process the input block. */
     for (;;) {
@@ -1946,11 +2840,16 @@ local block_state deflate_slow(s, flush)
         }
 
         /* Insert the string window[strstart .. strstart+2] in the
-         * dictionary, and set hash_head to the head of the hash chain:
+         * dictionary, and set hash_head to the head of the hash chain.
+         * Inserting the string in its tree instead finds its matches.
          */
         hash_head = NIL;
+        found = 0;
         if (s->lookahead >= MIN_MATCH) {
-            INSERT_STRING(s, s->strstart, hash_head);
+            if (s->use_tree)
+                found = tree_matches(s, s->strstart, s->lookahead, pairs);
+            else
+                INSERT_STRING(s, s->strstart, hash_head);
         }
 
         /* Find the longest match, discarding those <= prev_length.
@@ -1958,14 +2857,19 @@ local block_state deflate_slow(s, flush)
         s->prev_length = s->match_length, s->prev_match = s->match_start;
         s->match_length = MIN_MATCH-1;
 
-        if (hash_head != NIL && s->prev_length < s->max_lazy_match &&
-            s->strstart - hash_head <= MAX_DIST(s)) {
+        if (s->prev_length < s->max_lazy_match && (found ||
+            (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s)))) {
             /* To simplify the code, we prevent matches with the string
              * of window index 0 (in particular we have to avoid a match
              * of the string with itself at the start of the input file).
              */
-            s->match_length = longest_match (s, hash_head);
-            /* longest_match() sets match_start */
+            if (found) {
+                /* the longest match from the tree is the last */
+                s->match_length = pairs[2*found - 2];
+                s->match_start = s->strstart - pairs[2*found - 1];
+            }
+            else    /* longest_match() sets match_start */
+                s->match_length = longest_match (s, hash_head);
 
             if (s->match_length <= 5 && (s->strategy == Z_FILTERED
 #if TOO_FAR <= 32767
@@ -2001,7 +2905,12 @@ local block_state deflate_slow(s, flush)
             s->prev_length -= 2;
             do {
                 if (++s->strstart <= max_insert) {
-                    INSERT_STRING(s, s->strstart, hash_head);
+                    if (s->use_tree)
+                        tree_matches(s, s->strstart,
+                                     max_insert + MIN_MATCH - s->strstart,
+                                     Z_NULL);
+                    else
+                        INSERT_STRING(s, s->strstart, hash_head);
                 }
             } while (--s->prev_length != 0);
             s->match_available = 0;
@@ -2043,10 +2952,810 @@ local block_state deflate_slow(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
+
+/* ===========================================================================
+ * Return the length of the longest match for the string at strstart that is
+ * longer than prev, setting match_start, or 1 if there is no match worth
+ * using. The string at strstart has already been inserted, and hash_head is
+ * the previous head of its chain.
+ */
+local uInt medium_match(s, hash_head, prev)
+    deflate_state *s;
+    IPos hash_head;
+    uInt prev;
+{
+    uInt len;
+
+    if (hash_head == NIL || s->strstart - hash_head > MAX_DIST(s))
+        return 1;
+    s->prev_length = prev;
+    len = longest_match(s, hash_head);
+    s->prev_length = MIN_MATCH-1;       /* as deflate_fast() expects */
+    if (len <= prev)
+        return 1;
+    if (len < MIN_MATCH || (len <= 5 && (s->strategy == Z_FILTERED
+#if TOO_FAR <= 32767
+        || (len == MIN_MATCH && s->strstart - s->match_start > TOO_FAR)
+#endif
+        )))
+        return 1;
+    return len;
+}
+
+/* ===========================================================================
+ * Compress as much as possible from the input stream, return the current
+ * block state. This is used for the middle levels. Instead of the lazy
+ * evaluation of deflate_slow() at every position, it looks for the next match
+ * where the current one ends, and if that match can be extended backwards to
+ * take in all but at most one byte of the current match, the current match
+ * gives way to it. That finds most of what the lazy evaluation finds with
+ * about half the calls of longest_match(). A match shorter than max_lazy
+ * that starts a step is also checked against a match one byte later. All
+ * strings are inserted in the hash table, as for deflate_slow().
+ *
+ * The match found at the end of the current one is kept for the next step in
+ * match_length and match_start, with match_available set, to be used for the
+ * string at strstart. The strings from there through prev_match bytes later
+ * have already been inserted.
+ */
+local block_state deflate_medium(s, flush)
+    deflate_state *s;
+    int flush;
+{
+    IPos hash_head = NIL;       /* head of hash chain */
+    uInt clen;                  /* length of the match at strstart, or 1 */
+    IPos cstart;                /* start of that match */
+    uInt next;                  /* position after that match */
+    uInt nlen;                  /* length of the match at next, or 1 */
+    IPos nstart;                /* start of that match */
+    uInt back;                  /* bytes that the next match extends back */
+    uInt str;                   /* last string inserted */
+    int bflush;                 /* set if current block must be flushed */
+
+    for (;;) {
+        /* Make sure that we always have enough lookahead, except at the end
+         * of the input file. A match is only looked for at the end of the
+         * current one when there would be MIN_LOOKAHEAD there, so there is
+         * never such a match held over when more input is needed.
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            Assert(!s->match_available, "match held over");
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* flush the current block */
+        }
+
+        /* Get the match at strstart, from the last step or by looking now */
+        if (s->match_available) {
+            clen = s->match_length;
+            cstart = s->match_start;
+            str = s->strstart + s->prev_match;
+            s->match_length = MIN_MATCH-1;  /* as deflate_slow() expects */
+            s->match_available = 0;
+        }
+        else {
+            hash_head = NIL;
+            if (s->lookahead >= MIN_MATCH) {
+                INSERT_STRING(s, s->strstart, hash_head);
+            }
+            clen = medium_match(s, hash_head, MIN_MATCH-1);
+            cstart = s->match_start;
+            str = s->strstart;
+        }
+
+        /* As for deflate_slow(), if the match is short, see if there is a
+         * longer one at the next position, and if so, emit a literal.
+         */
+        if (clen >= MIN_MATCH && clen < s->max_lazy_match &&
+            str == s->strstart && s->lookahead > MIN_LOOKAHEAD) {
+            str++;
+            INSERT_STRING(s, str, hash_head);
+            s->strstart = str;
+            nlen = medium_match(s, hash_head, clen);
+            s->strstart--;
+            if (nlen > clen) {
+                s->match_length = nlen;
+                s->prev_match = 0;
+                s->match_available = 1;
+                clen = 1;
+            }
+        }
+
+        /* Insert the rest of the strings in the match, and if there will be
+         * enough lookahead, the string after it, to look for the next match.
+         */
+        next = s->strstart + clen;
+        if (!s->match_available && s->lookahead - clen >= MIN_LOOKAHEAD) {
+            while (++str <= next) {
+                INSERT_STRING(s, str, hash_head);
+            }
+            s->strstart = next;
+            nlen = medium_match(s, hash_head, MIN_MATCH-1);
+            nstart = s->match_start;
+            s->strstart = next - clen;
+
+            /* See how far the next match extends backwards into this one,
+             * and if that leaves no more than a literal, then use it.
+             */
+            back = 0;
+            if (nlen >= MIN_MATCH)
+                while (back < clen && nlen + back < MAX_MATCH &&
+                       nstart > back &&
+                       s->window[nstart - back - 1] ==
+                       s->window[next - back - 1])
+                    back++;
+            if (back != 0 && clen - back <= 1) {
+                clen -= back;
+                nlen += back;
+                nstart -= back;
+            }
+            else
+                back = 0;
+            s->match_length = nlen;
+            s->match_start = nstart;
+            s->prev_match = back;
+            s->match_available = 1;
+        }
+        else {
+            uInt max_insert = s->strstart + s->lookahead - MIN_MATCH;
+            /* Do not insert strings in hash table beyond this. */
+
+            while (++str < next && str <= max_insert) {
+                INSERT_STRING(s, str, hash_head);
+            }
+        }
+
+        /* Emit the match, or the literal or nothing left of it */
+        bflush = 0;
+        if (clen >= MIN_MATCH) {
+            check_match(s, s->strstart, cstart, clen);
+            _tr_tally_dist(s, s->strstart - cstart, clen - MIN_MATCH, bflush);
+        }
+        else if (clen) {
+            Tracevv((stderr,"%c", s->window[s->strstart]));
+            _tr_tally_lit(s, s->window[s->strstart], bflush);
+        }
+        s->strstart += clen;
+        s->lookahead -= clen;
+        if (bflush) FLUSH_BLOCK(s, 0);
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
+
+/* Where a deflate_quick() block began in the pending output, so that it can
+ * be replaced by a stored block if that turns out to be smaller. pending is
+ * QUICK_GONE if the block was begun in an earlier deflate() call, since the
+ * pending output from then may have already been delivered.
+ */
+typedef struct quick_mark_s {
+    ulg pending;
+    BitBuf bi_buf;
+    int bi_valid;
+#ifdef ZLIB_DEBUG
+    ulg compressed_len;
+    ulg bits_sent;
+#endif
+} quick_mark;
+
+#define QUICK_GONE ((ulg)-1)
+
+/* Room to leave in pending_buf for one more literal or match, the end of the
+ * block, and the bit buffer, or for the stored block replacing it.
+ */
+#define QUICK_ROOM 16
+
+local void quick_start OF((deflate_state *s, quick_mark *m, int last));
+local void quick_end   OF((deflate_state *s, quick_mark *m));
+
+/* ===========================================================================
+ * Start a deflate_quick() block, noting where it began in m.
+ */
+local void quick_start(s, m, last)
+    deflate_state *s;
+    quick_mark *m;
+    int last;
+{
+    m->pending = s->pending;
+    m->bi_buf = s->bi_buf;
+    m->bi_valid = s->bi_valid;
+#ifdef ZLIB_DEBUG
+    m->compressed_len = s->compressed_len;
+    m->bits_sent = s->bits_sent;
+#endif
+    _tr_quick_start(s, last);
+    s->block_start = (long)s->strstart;
+    s->block_open = 1 + last;
+}
+
+/* ===========================================================================
+ * End the current deflate_quick() block. If the static codes came out larger
+ * than a stored block would be, as they can for incompressible data, then
+ * back up to the start of the block and write it stored instead. This keeps
+ * the result within deflateBound().
+ */
+local void quick_end(s, m)
+    deflate_state *s;
+    quick_mark *m;
+{
+    int last = s->block_open == 2;
+    ulg bits, len;
+
+    _tr_quick_end(s, last);
+    s->block_open = 0;
+    len = (ulg)((long)s->strstart - s->block_start);
+    s->block_start = (long)s->strstart;
+    if (m->pending == QUICK_GONE)
+        return;
+    bits = ((s->pending - m->pending) << 3) + s->bi_valid - m->bi_valid;
+    if (len + 4 <= (bits + 7) >> 3) {
+        Assert(s->block_start - (long)len >= 0L, "quick block slid away");
+        s->pending = m->pending;
+        s->bi_buf = m->bi_buf;
+        s->bi_valid = m->bi_valid;
+#ifdef ZLIB_DEBUG
+        s->compressed_len = m->compressed_len;
+        s->bits_sent = m->bits_sent;
+#endif
+        _tr_stored_block(s, (charf *)s->window + s->block_start - len, len,
+                         last);
+    }
+    m->pending = QUICK_GONE;
+}
+
+/* ===========================================================================
+ * Compress as much as possible from the input stream, return the current
+ * block state. This is used for level 1 with the Z_FIXED strategy, in place
+ * of deflate_fast(), which would also send static blocks. Like it, it does not
+ * perform lazy evaluation of matches, but it also checks only the most
+ * recent string with the same hash for a match, and does not insert the
+ * strings inside of a match. The literals and matches are written out as
+ * they are found using the static trees, avoiding the work of saving them
+ * and building dynamic trees, at some cost in compression.
+ */
+local block_state deflate_quick(s, flush)
+    deflate_state *s;
+    int flush;
+{
+    IPos hash_head;       /* most recent string with the same hash */
+    Bytef *scan;          /* the string at strstart */
+    Bytef *match;         /* the string at hash_head */
+    uInt len;             /* length of the match at strstart */
+    quick_mark m;         /* where the open block began */
+
+    m.pending = QUICK_GONE;
+    for (;;) {
+        /* Make sure that we always have enough lookahead, except at the end
+         * of the input file, as for deflate_fast(). Since the block may need
+         * to be stored, end it before fill_window() slides out its start.
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            if (s->block_open && m.pending != QUICK_GONE &&
+                s->strstart >= s->w_size + MAX_DIST(s) &&
+                s->block_start < (long)s->w_size)
+                quick_end(s, &m);
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* end the current block */
+        }
+
+        /* End the block if the pending buffer is full. Before starting a
+         * new one, deliver the pending output if there is room to.
+         */
+        if (s->block_open == 1 &&
+            s->pending + QUICK_ROOM > s->pending_buf_size)
+            quick_end(s, &m);
+        if (!s->block_open) {
+            if (s->pending) {
+                flush_pending(s->strm);
+                if (s->strm->avail_out == 0) return need_more;
+            }
+
+            /* This can be the last block if the rest of the input is all
+             * here, fits in pending_buf with the worst-case expansion of
+             * nine bits per byte, and can be stored if needed without
+             * sliding out the start of the block.
+             */
+            quick_start(s, &m, flush == Z_FINISH && s->strm->avail_in == 0 &&
+                (s->strstart + s->lookahead < s->w_size + MAX_DIST(s) ||
+                 s->strstart >= s->w_size) &&
+                s->pending + s->lookahead + (s->lookahead >> 3) + QUICK_ROOM <=
+                s->pending_buf_size);
+        }
+
+        /* Insert the string window[strstart .. strstart+2] in the
+         * dictionary, and check the string that was there before for a match.
+         * As in longest_match(), strstart is at most
+         * window_size-MIN_LOOKAHEAD, so compare256() can read MAX_MATCH bytes
+         * at strstart.
+         */
+        if (s->lookahead >= MIN_MATCH) {
+            INSERT_STRING(s, s->strstart, hash_head);
+            if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s)) {
+                scan = s->window + s->strstart;
+                match = s->window + hash_head;
+                if (scan[0] == match[0] && scan[1] == match[1]) {
+                    len = 2 + z_kernels.compare256(scan + 2, match + 2);
+                    if (len > s->lookahead)
+                        len = s->lookahead;
+                    if (len >= MIN_MATCH) {
+                        check_match(s, s->strstart, hash_head, (int)len);
+                        _tr_quick_dist(s, s->strstart - hash_head, len);
+                        s->lookahead -= len;
+                        s->strstart += len;
+                        s->ins_h = s->window[s->strstart];
+                        UPDATE_HASH(s, s->ins_h, s->window[s->strstart+1]);
+#if MIN_MATCH != 3
+                        Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+                        continue;
+                    }
+                }
+            }
+        }
+
+        /* No match, output a literal byte */
+        Tracevv((stderr,"%c", s->window[s->strstart]));
+        _tr_quick_lit(s, s->window[s->strstart]);
+        s->lookahead--;
+        s->strstart++;
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        /* If the open block could not be made the last one, follow it with
+         * an empty last block.
+         */
+        if (s->block_open == 1)
+            quick_end(s, &m);
+        if (s->block_open == 0)
+            quick_start(s, &m, 1);
+        quick_end(s, &m);
+        flush_pending(s->strm);
+        return s->strm->avail_out == 0 ? finish_started : finish_done;
+    }
+    if (s->block_open) {
+        quick_end(s, &m);
+        flush_pending(s->strm);
+        if (s->strm->avail_out == 0) return need_more;
+    }
+    return block_done;
+}
+
+/* ===========================================================================
+ * Compress as much as possible from the input stream, return the current
+ * block state. This is used for level 10, which spends much more time
+ * for a smaller result. Up to OPT_CHUNK bytes of input are parsed at once,
+ * and the last match of a chunk can run past that.
+ * All of the useful matches at each position are found first, and then the
+ * cheapest sequence of literals and matches that covers the chunk, given the
+ * cost in bits of each symbol. The first pass uses the costs left by the
+ * chunk before, or those of the static codes. Each later pass uses costs
+ * estimated from the symbols chosen by the pass before, until that no longer
+ * makes the estimated size smaller or lazy passes have been made. The parse
+ * is then emitted as for the other levels, so _tr_flush_block() still makes
+ * the blocks and their codes.
+ */
+local block_state deflate_optimal(s, flush)
+    deflate_state *s;
+    int flush;
+{
+    opt_node FAR *opt = s->opt;
+    uInt n;                     /* bytes to parse */
+    uInt step;                  /* length of the next step of the parse */
+    uInt back;                  /* distance of that step if a match */
+    int bflush;                 /* set if current block must be flushed */
+
+    for (;;) {
+        /* Parse another chunk when all of the last one has been emitted. As
+         * for deflate_slow(), MIN_LOOKAHEAD-1 bytes are left for later,
+         * except at the end of the input, which a flush only reaches once
+         * all of avail_in is in the window.
+         */
+        if (s->opt_pos == s->opt_end) {
+            if (s->lookahead < MIN_LOOKAHEAD) {
+                fill_window(s);
+                if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                    return need_more;
+                }
+                if (s->lookahead == 0) break; /* flush the current block */
+            }
+            n = s->lookahead;
+            if (s->lookahead >= MIN_LOOKAHEAD &&
+                (flush == Z_NO_FLUSH || s->strm->avail_in != 0))
+                n -= MIN_LOOKAHEAD-1;
+            if (n > OPT_CHUNK)
+                n = OPT_CHUNK;
+            s->opt_end = opt_parse(s, n);
+            s->opt_pos = 0;
+        }
+
+        /* Emit the next literal or match of the parse */
+        step = (uInt)opt[s->opt_pos].cost;
+        if (step == 1) {
+            Tracevv((stderr,"%c", s->window[s->strstart]));
+            _tr_tally_lit(s, s->window[s->strstart], bflush);
+        }
+        else {
+            back = opt[s->opt_pos + step].dist;
+            check_match(s, s->strstart, s->strstart - back, step);
+            _tr_tally_dist(s, back, step - MIN_MATCH, bflush);
+        }
+        s->opt_pos += step;
+        s->strstart += step;
+        s->lookahead -= step;
+        if (bflush) FLUSH_BLOCK(s, 0);
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    if (s->sym_next)
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
+
+/* ===========================================================================
+ * Parse the n bytes at strstart for deflate_optimal(), inserting their
+ * strings in the hash table, and return the number of bytes parsed. That is
+ * less than n if the matches found filled opt_match, or more if the last step
+ * of the parse is a match that runs past n. The steps of the parse are left
+ * in the cost of each position of opt[] that starts one.
+ */
+local uInt opt_parse(s, n)
+    deflate_state *s;
+    uInt n;
+{
+    opt_node FAR *opt = s->opt;
+    ushf *pairs = s->opt_match;
+    ulg room = OPT_PAIRS;           /* pairs left in opt_match */
+    IPos hash_head;                 /* head of the hash chain */
+    uInt i, k, str, end;
+    uInt skip;                      /* strings to insert without searching */
+    uInt pass;
+    ulg size, best;                 /* estimated bits of the parse */
+    ush lit[L_CODES], dist[D_CODES];            /* costs for this pass */
+    ush next_lit[L_CODES], next_dist[D_CODES];  /* costs from this pass */
+    ush best_lit[L_CODES], best_dist[D_CODES];  /* costs for the best pass */
+
+    /* Find the matches at each position. opt_matches() and tree_matches()
+     * add at most one pair for each match length. The matches can run past
+     * the chunk into the rest of the lookahead. Once a match of nice_match
+     * or more is found, the strings it covers are only inserted, since that
+     * match will almost always be used.
+     */
+    skip = 0;
+    for (i = 0; i < n; i++) {
+        if (room < MAX_MATCH-MIN_MATCH+1) {
+            n = i;
+            break;
+        }
+        str = s->strstart + i;
+        k = 0;
+        if (s->lookahead - i >= MIN_MATCH && s->use_tree) {
+            if (skip)
+                tree_matches(s, str, s->lookahead - i, Z_NULL);
+            else
+                k = tree_matches(s, str, s->lookahead - i, pairs);
+        }
+        else if (s->lookahead - i >= MIN_MATCH) {
+            INSERT_STRING(s, str, hash_head);
+            if (!skip && hash_head != NIL && str - hash_head <= MAX_DIST(s))
+                k = opt_matches(s, str, hash_head, s->lookahead - i,
+                                pairs);
+        }
+        if (skip)
+            skip--;
+        opt[i].pairs = (ush)k;
+        pairs += 2 * k;
+        room -= k;
+        if (k && pairs[-2] >= (uInt)s->nice_match)
+            skip = pairs[-2] - 1;
+    }
+
+    /* Parse with the costs from the chunk before, or with the static code
+     * lengths for the first chunk, then with each new set of costs, until
+     * the estimated size stops getting smaller. These parses all end at n,
+     * so that their sizes can be compared. Keep the costs from the parse
+     * used to start the next chunk.
+     */
+    if (s->opt_cost[0]) {
+        zmemcpy((Bytef *)lit, (Bytef *)s->opt_cost, sizeof(lit));
+        zmemcpy((Bytef *)dist, (Bytef *)(s->opt_cost + L_CODES), sizeof(dist));
+    }
+    else {
+        for (i = 0; i < L_CODES; i++)
+            lit[i] = (ush)(OPT_BIT *
+                           (i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8));
+        for (i = 0; i < D_CODES; i++)
+            dist[i] = (ush)(OPT_BIT * 5);
+    }
+    best = (ulg)-1;
+    for (pass = 1;; pass++) {
+        opt_path(s, n, lit, dist, 0);
+        size = opt_stats(s, n, next_lit, next_dist);
+        if (size >= best)
+            /* no better than the pass before -- go back to that one, which
+             * gave the costs just used
+             */
+            break;
+        best = size;
+        zmemcpy((Bytef *)best_lit, (Bytef *)lit, sizeof(lit));
+        zmemcpy((Bytef *)best_dist, (Bytef *)dist, sizeof(dist));
+        zmemcpy((Bytef *)lit, (Bytef *)next_lit, sizeof(lit));
+        zmemcpy((Bytef *)dist, (Bytef *)next_dist, sizeof(dist));
+        if (pass >= s->max_lazy_match)
+            break;
+    }
+    zmemcpy((Bytef *)s->opt_cost, (Bytef *)lit, sizeof(lit));
+    zmemcpy((Bytef *)(s->opt_cost + L_CODES), (Bytef *)dist, sizeof(dist));
+
+    /* Make the parse to use with the best costs, letting its last step run
+     * past n if that is cheaper, and insert the strings that step covers.
+     */
+    end = opt_path(s, n, best_lit, best_dist, 1);
+    for (i = n; i < end; i++) {
+        if (s->lookahead - i < MIN_MATCH)
+            break;
+        str = s->strstart + i;
+        if (s->use_tree)
+            tree_matches(s, str, s->lookahead - i, Z_NULL);
+        else
+            INSERT_STRING(s, str, hash_head);
+    }
+    return end;
+}
+
+/* ===========================================================================
+ * Put in pairs the lengths and distances of the matches for the string at
+ * str, each longer than the one before, and return how many there are. The
+ * nearest match of each length is found, so a length and distance pair
+ * stands for all of the lengths down to the length of the pair before, or
+ * MIN_MATCH. The matches are no longer than most.
+ * IN assertion: cur_match is the head of the hash chain for str, and its
+ *   distance is <= MAX_DIST
+ */
+local uInt opt_matches(s, str, cur_match, most, pairs)
+    deflate_state *s;
+    IPos str;                                   /* current string */
+    IPos cur_match;                             /* current match */
+    uInt most;                                  /* longest match to find */
+    ushf *pairs;                                /* lengths and distances */
+{
+    unsigned chain_length = s->max_chain_length;/* max hash chain length */
+    Bytef *scan = s->window + str;
+    Bytef *match;
+    uInt len;
+    uInt best_len = MIN_MATCH-1;                /* best match length so far */
+    uInt found = 0;                             /* pairs found */
+    IPos limit = str > (IPos)MAX_DIST(s) ? str - (IPos)MAX_DIST(s) : NIL;
+    Posf *prev = s->prev;
+    uInt wmask = s->w_mask;
+    IPos base = POS_BASE(s);
+
+    if (most > MAX_MATCH)
+        most = MAX_MATCH;
+    if ((uInt)s->nice_match < most)
+        most = (uInt)s->nice_match;
+    if (most < MIN_MATCH)
+        return 0;
+
+    cur_match += base;
+    limit += base;
+    do {
+        Assert(cur_match - base < str, "no future");
+        match = s->window + (cur_match - base);
+        if (match[best_len] != scan[best_len] ||
+            match[0] != scan[0] || match[1] != scan[1]) continue;
+
+        /* compare256() may read MAX_MATCH bytes from str, so only use it when
+         * those are in the window
+         */
+        if (most == MAX_MATCH && str + MAX_MATCH <= s->window_size)
+            len = 2 + z_kernels.compare256(scan + 2, match + 2);
+        else
+            for (len = 2; len < most && scan[len] == match[len]; len++)
+                ;
+        if (len > best_len) {
+            pairs[0] = (ush)len;
+            pairs[1] = (ush)(str - (cur_match - base));
+            pairs += 2;
+            found++;
+            best_len = len;
+            if (len >= most) break;
+        }
+    } while ((cur_match = prev[cur_match & wmask]) > limit
+             && --chain_length != 0);
+    return found;
+}
+
+/* ===========================================================================
+ * Find the cheapest path through the n positions of opt[] with the given
+ * costs of the literal/length and distance codes, using the matches found by
+ * opt_parse(). Then put the length of each step of that path in the cost of
+ * the position that starts it, and return where the path ends. That is n,
+ * unless past is true and a path whose last step is a match that runs past n
+ * is cheaper. The bytes past n are credited at the average cost per byte of
+ * the path to n, since the next chunk would otherwise have to cover them.
+ */
+local uInt opt_path(s, n, lit, dist, past)
+    deflate_state *s;
+    uInt n;
+    const ush *lit;
+    const ush *dist;
+    int past;
+{
+    opt_node FAR *opt = s->opt;
+    ushf *pairs = s->opt_match;
+    Bytef *window = s->window + s->strstart;
+    ush len_cost[MAX_MATCH+1];      /* cost of each match length */
+    uInt i, k, len, top, end;
+    ulg here, cost, base, avg;
+    int code;
+
+    for (len = MIN_MATCH; len <= MAX_MATCH; len++) {
+        code = _length_code[len - MIN_MATCH];
+        len_cost[len] = (ush)(lit[LITERALS + 1 + code] +
+                              OPT_BIT * LEN_EXTRA(code));
+    }
+
+    /* Find the cheapest way to reach each position from the ones before */
+    opt[0].cost = 0;
+    for (i = 1; i < n + MAX_MATCH; i++)
+        opt[i].cost = (ulg)-1;
+    for (i = 0; i < n; i++) {
+        here = opt[i].cost;
+        cost = here + lit[window[i]];
+        if (cost < opt[i + 1].cost) {
+            opt[i + 1].cost = cost;
+            opt[i + 1].len = 1;
+        }
+        len = MIN_MATCH;
+        for (k = opt[i].pairs; k; k--, pairs += 2) {
+            top = pairs[0];
+            code = d_code(pairs[1] - 1);
+            base = here + dist[code] + OPT_BIT * DIST_EXTRA(code);
+            for (; len <= top; len++) {
+                cost = base + len_cost[len];
+                if (cost < opt[i + len].cost) {
+                    opt[i + len].cost = cost;
+                    opt[i + len].len = (ush)len;
+                    opt[i + len].dist = pairs[1];
+                }
+            }
+        }
+    }
+
+    /* Choose where to end */
+    end = n;
+    if (past) {
+        avg = opt[n].cost / n;
+        for (i = n + 1; i < n + MAX_MATCH; i++)
+            if (opt[i].cost != (ulg)-1 &&
+                opt[i].cost + (end - n) * avg < opt[end].cost + (i - n) * avg)
+                end = i;
+    }
+
+    /* Go back from the end to leave the steps to take */
+    i = end;
+    while (i) {
+        len = opt[i].len;
+        i -= len;
+        opt[i].cost = len;
+    }
+    return end;
+}
+
+/* ===========================================================================
+ * Count the symbols of the parse left in opt[] by opt_path(), set lit and
+ * dist to the costs of the codes estimated from those counts, and return the
+ * estimated size in bits (times OPT_BIT) of the parse with those costs.
+ */
+local ulg opt_stats(s, n, lit, dist)
+    deflate_state *s;
+    uInt n;
+    ush *lit;
+    ush *dist;
+{
+    opt_node FAR *opt = s->opt;
+    Bytef *window = s->window + s->strstart;
+    ulg lit_freq[L_CODES], dist_freq[D_CODES];
+    ulg size = 0;
+    uInt i, step;
+    int code;
+
+    for (code = 0; code < L_CODES; code++) lit_freq[code] = 0;
+    for (code = 0; code < D_CODES; code++) dist_freq[code] = 0;
+    lit_freq[LITERALS] = 1;         /* end of block */
+    for (i = 0; i < n; i += step) {
+        step = (uInt)opt[i].cost;
+        if (step == 1)
+            lit_freq[window[i]]++;
+        else {
+            code = _length_code[step - MIN_MATCH];
+            lit_freq[LITERALS + 1 + code]++;
+            size += OPT_BIT * LEN_EXTRA(code);
+            code = d_code(opt[i + step].dist - 1);
+            dist_freq[code]++;
+            size += OPT_BIT * DIST_EXTRA(code);
+        }
+    }
+    opt_costs(lit_freq, lit, L_CODES);
+    opt_costs(dist_freq, dist, D_CODES);
+    for (code = 0; code < L_CODES; code++)
+        size += lit_freq[code] * lit[code];
+    for (code = 0; code < D_CODES; code++)
+        size += dist_freq[code] * dist[code];
+    return size;
+}
+
+/* ===========================================================================
+ * Set the cost of each of the n symbols to the bits it would take given its
+ * count in freq, -log2 of its share of the total, limited to what a Huffman
+ * code can use. A symbol not seen costs as much as one seen once.
+ */
+local void opt_costs(freq, cost, n)
+    ulg *freq;
+    ush *cost;
+    int n;
+{
+    ulg total = 0, all, bits;
+    int i;
+
+    for (i = 0; i < n; i++)
+        total += freq[i];
+    all = opt_log2(total ? total : (ulg)n);
+    for (i = 0; i < n; i++) {
+        bits = all - opt_log2(freq[i] ? freq[i] : 1);
+        if (bits < OPT_BIT)
+            bits = OPT_BIT;
+        if (bits > OPT_BIT * MAX_BITS)
+            bits = OPT_BIT * MAX_BITS;
+        cost[i] = (ush)bits;
+    }
+}
+
+/* ===========================================================================
+ * Return log2(x) times OPT_BIT, rounded down, for x > 0. The fraction is
+ * found a bit at a time by squaring x scaled to 1.15 fixed point.
+ */
+local ulg opt_log2(x)
+    ulg x;
+{
+    ulg r = 15 * OPT_BIT;
+    unsigned bit;
+
+    while (x >= 0x10000) {
+        x >>= 1;
+        r += OPT_BIT;
+    }
+    while (x < 0x8000) {
+        x <<= 1;
+        r -= OPT_BIT;
+    }
+    for (bit = OPT_BIT >> 1; bit; bit >>= 1) {
+        x = (x * x) >> 15;
+        if (x >= 0x10000) {
+            x >>= 1;
+            r += bit;
+        }
+    }
+    return r;
+}
 #endif /* FASTEST */
 
 /* ===========================================================================
@@ -2118,7 +3827,7 @@ local block_state deflate_rle(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
@@ -2157,7 +3866,7 @@ local block_state deflate_huff(s, flush)
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->last_lit)
+    if (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
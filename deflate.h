@@ -48,8 +48,15 @@
 #define MAX_BITS 15
 /* All codes must not exceed MAX_BITS bits */
 
-#define Buf_size 16
-/* size of bit buffer in bi_buf */
+#ifdef BIT64
+   typedef BIT64 BitBuf;
+#  define Buf_size 64
+#else
+   typedef ush BitBuf;
+#  define Buf_size 16
+#endif
+/* type and size of bit buffer in bi_buf -- with BIT64 (see zutil.h),
+   send_bits() writes eight bytes at a time to pending_buf instead of two */
 
 #define INIT_STATE    42    /* zlib header -> BUSY_STATE */
 #ifdef GZIP
@@ -89,12 +96,40 @@ typedef struct tree_desc_s {
     const static_tree_desc *stat_desc;  /* the corresponding static tree */
 } FAR tree_desc;
 
-typedef ush Pos;
+/* define POS32 when compiling to keep 32-bit positions in the hash tables.
+   This doubles the memory used by head[] and prev[], but sliding the window
+   then leaves those tables alone, instead of rewriting every entry of both
+   each time another w_size bytes of input have been read. */
+#ifdef POS32
+#  ifdef Z_U4
+     typedef Z_U4 Pos;
+#  else
+     typedef ulg Pos;
+#  endif
+#else
+   typedef ush Pos;
+#endif
 typedef Pos FAR Posf;
 typedef unsigned IPos;
 
 /* A Pos is an index in the character window. We use short instead of int to
  * save space in the various tables. IPos is used only for parameter passing.
+ * With POS32, a Pos in the tables is instead the window index plus pos_base,
+ * which slide_hash() advances by w_size rather than subtracting w_size from
+ * each entry. Entries at or below pos_base have slid out of the window and
+ * act as NIL.
+ */
+
+typedef struct opt_node_s {
+    ulg cost;           /* least cost of reaching here, then the step onward */
+    ush len;            /* length of the step ending here, 1 for a literal */
+    ush dist;           /* distance of that step if a match */
+    ush pairs;          /* number of matches found here, in opt_match */
+} opt_node;
+
+/* A position in the chunk of input parsed by deflate_optimal(). The cheapest
+ * way to reach each position is found from the start of the chunk, and then
+ * cost is reused for the steps of that cheapest path, taken from the end.
  */
 
 typedef struct internal_state {
@@ -123,12 +158,18 @@ typedef struct internal_state {
      * wSize-MAX_MATCH bytes, but this ensures that IO is always
      * performed with a length multiple of the block size. Also, it limits
      * the window size to 64K, which is quite useful on MSDOS.
-     * To do: use the user input buffer as sliding window.
+     * For a deflate() call with Z_FINISH and all of the input, window can
+     * instead point into the user input buffer, for the duration of the call.
      */
 
     ulg window_size;
-    /* Actual size of window: 2*wSize, except when the user input buffer
-     * is directly used as sliding window.
+    /* Actual size of window: 2*wSize, also when the user input buffer is
+     * directly used as sliding window.
+     */
+
+    Bytef *window_buf;
+    /* The allocated window while window points into the input, or else
+     * Z_NULL.
      */
 
     Posf *prev;
@@ -139,6 +180,24 @@ typedef struct internal_state {
 
     Posf *head; /* Heads of the hash chains or NIL. */
 
+    Posf *tree;
+    /* Two links for each of the last w_size strings, instead of prev[], when
+     * the tree match finder is used: to the strings less than and greater
+     * than it in the binary tree of strings with the same hash index, whose
+     * root is in head[]. Z_NULL until the tree match finder is first needed.
+     */
+
+    int match_method;    /* match finder set by deflateSetMatch() */
+    int use_tree;        /* true if the tree match finder is in use */
+
+#ifdef POS32
+    ulg pos_base;
+    /* Value added to window indices stored in head[], prev[], and tree[],
+     * always a multiple of w_size. It is reset to zero by subtracting it from
+     * every entry only once it reaches POS_REBASE, after about 2GB of input.
+     */
+#endif
+
     uInt  ins_h;          /* hash index of string to be inserted */
     uInt  hash_size;      /* number of elements in hash table */
     uInt  hash_bits;      /* log2(hash_size) */
@@ -151,6 +210,12 @@ typedef struct internal_state {
      *   hash_shift * MIN_MATCH >= hash_bits
      */
 
+    uInt (*hash_calc) OF((struct internal_state FAR *s, uInt str));
+    /* Hash of the four bytes at window index str, or Z_NULL to use the
+     * running hash of MIN_MATCH bytes with hash_shift. Set by
+     * deflateSetHash().
+     */
+
     long block_start;
     /* Window position at the beginning of the current output block. Gets
      * negative when the window is moved backwards.
@@ -217,7 +282,7 @@ typedef struct internal_state {
     /* Depth of each subtree used as tie breaker for trees of equal frequency
      */
 
-    uchf *l_buf;          /* buffer for literals or lengths */
+    uchf *sym_buf;        /* buffer for distances and literals/lengths */
 
     uInt  lit_bufsize;
     /* Size of match buffer for literals/lengths.  There are 4 reasons for
@@ -239,25 +304,32 @@ typedef struct internal_state {
      *   - I can't count above 4
      */
 
-    uInt last_lit;      /* running index in l_buf */
-
-    ushf *d_buf;
-    /* Buffer for distances. To simplify the code, d_buf and l_buf have
-     * the same number of elements. To use different lengths, an extra flag
-     * array would be necessary.
+    uInt sym_next;      /* running index in sym_buf */
+    uInt sym_end;       /* symbol table full when sym_next reaches this */
+    /* sym_buf holds three bytes for each literal or match, the distance low
+     * byte then high byte, zero for a literal, and then the literal or the
+     * match length - MIN_MATCH. Both the tallies and compress_block() then
+     * go through the symbols in one sequential stream.
      */
 
     ulg opt_len;        /* bit length of current block with optimal trees */
     ulg static_len;     /* bit length of current block with static trees */
     uInt matches;       /* number of string matches in current block */
     uInt insert;        /* bytes at end of window left to insert */
+    int block_open;     /* deflate_quick() block open: 1, or 2 if the last */
+
+    opt_node FAR *opt;  /* optimal parse of level 10, or Z_NULL */
+    ushf *opt_match;    /* lengths and distances of the matches found */
+    ushf *opt_cost;     /* costs of the codes to start the next chunk with */
+    uInt opt_pos;       /* next position of the parse to emit */
+    uInt opt_end;       /* number of positions parsed */
 
 #ifdef ZLIB_DEBUG
     ulg compressed_len; /* total bit length of compressed file mod 2^32 */
     ulg bits_sent;      /* bit length of compressed data sent mod 2^32 */
 #endif
 
-    ush bi_buf;
+    BitBuf bi_buf;
     /* Output buffer. bits are inserted starting at the bottom (least
      * significant bits).
      */
@@ -295,6 +367,19 @@ typedef struct internal_state {
 /* Number of bytes after end of data in window to initialize in order to avoid
    memory checker errors from longest match routines */
 
+/* A deflateSave() image is SAVED bytes of state, then the pending output,
+ * then up to w_size bytes of history, oldest first. The hash tables are not
+ * saved: deflateRestore() sets insert to the length of the history, so that
+ * fill_window() hashes it again when the next input arrives. The values in
+ * the state are little-endian, and the layout is, by offset: 0 format
+ * (1 byte), 1 status (2), 3 wrap + 2 (1), 4 w_bits, 5 level, 6 strategy,
+ * 7 hash method, 8 match method, 9 last_flush + 1, 10 strm->data_type,
+ * 11 bi_valid, 12 bi_buf (8), 20 good_match (4), 24 max_lazy_match,
+ * 28 nice_match, 32 max_chain_length, 36 strm->adler, 40 strm->total_in (8),
+ * 48 strm->total_out, 56 pending (4), and 60 history length.
+ */
+#define SAVED 64
+
         /* in trees.c */
 void ZLIB_INTERNAL _tr_init OF((deflate_state *s));
 int ZLIB_INTERNAL _tr_tally OF((deflate_state *s, unsigned dist, unsigned lc));
@@ -304,6 +389,11 @@ void ZLIB_INTERNAL _tr_flush_bits OF((deflate_state *s));
 void ZLIB_INTERNAL _tr_align OF((deflate_state *s));
 void ZLIB_INTERNAL _tr_stored_block OF((deflate_state *s, charf *buf,
                         ulg stored_len, int last));
+void ZLIB_INTERNAL _tr_quick_start OF((deflate_state *s, int last));
+void ZLIB_INTERNAL _tr_quick_lit OF((deflate_state *s, unsigned c));
+void ZLIB_INTERNAL _tr_quick_dist OF((deflate_state *s, unsigned dist,
+                        unsigned lc));
+void ZLIB_INTERNAL _tr_quick_end OF((deflate_state *s, int last));
 
 #define d_code(dist) \
    ((dist) < 256 ? _dist_code[dist] : _dist_code[256+((dist)>>7)])
@@ -312,9 +402,6 @@ void ZLIB_INTERNAL _tr_stored_block OF((deflate_state *s, charf *buf,
  * used.
  */
 
-#ifndef ZLIB_DEBUG
-/* Inline versions of _tr_tally for speed: */
-
 #if defined(GEN_TREES_H) || !defined(STDC)
   extern uch ZLIB_INTERNAL _length_code[];
   extern uch ZLIB_INTERNAL _dist_code[];
@@ -323,22 +410,27 @@ void ZLIB_INTERNAL _tr_stored_block OF((deflate_state *s, charf *buf,
   extern const uch ZLIB_INTERNAL _dist_code[];
 #endif
 
+#ifndef ZLIB_DEBUG
+/* Inline versions of _tr_tally for speed: */
+
 # define _tr_tally_lit(s, c, flush) \
   { uch cc = (c); \
-    s->d_buf[s->last_lit] = 0; \
-    s->l_buf[s->last_lit++] = cc; \
+    s->sym_buf[s->sym_next++] = 0; \
+    s->sym_buf[s->sym_next++] = 0; \
+    s->sym_buf[s->sym_next++] = cc; \
     s->dyn_ltree[cc].Freq++; \
-    flush = (s->last_lit == s->lit_bufsize-1); \
+    flush = (s->sym_next == s->sym_end); \
    }
 # define _tr_tally_dist(s, distance, length, flush) \
   { uch len = (uch)(length); \
     ush dist = (ush)(distance); \
-    s->d_buf[s->last_lit] = dist; \
-    s->l_buf[s->last_lit++] = len; \
+    s->sym_buf[s->sym_next++] = (uch)dist; \
+    s->sym_buf[s->sym_next++] = (uch)(dist >> 8); \
+    s->sym_buf[s->sym_next++] = len; \
     dist--; \
     s->dyn_ltree[_length_code[len]+LITERALS+1].Freq++; \
     s->dyn_dtree[d_code(dist)].Freq++; \
-    flush = (s->last_lit == s->lit_bufsize-1); \
+    flush = (s->sym_next == s->sym_end); \
   }
 #else
 # define _tr_tally_lit(s, c, flush) flush = _tr_tally(s, 0, c)
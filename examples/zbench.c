@@ -0,0 +1,220 @@
+/* zbench.c -- measure the speed of deflate() and inflate() on files in memory
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+   zbench [ -lN[-M] ] [ -rN ] [ -wN ] [ -mN ] [ -sN ] file ...
+
+   reads each file into memory, and then compresses and decompresses it in
+   memory at each of the levels N through M (default 6 through 9), reporting
+   the compressed size and the speed of each in MB/s of uncompressed data.
+   The best of -r runs (default 3) is reported, since the speed can only be
+   slowed by other activity.  -w and -m set the windowBits and memLevel given
+   to deflateInit2() (default 15 and 8).  The whole file is compressed with
+   one deflate() call unless -s gives a size for the input and output chunks
+   in bytes, which makes it a streaming test.  Every decompression is checked
+   against the original data.
+
+   To see what a change to zlib does, link zbench with zlib before and after
+   the change, and run both on the same files.  Use files of 100MB or more to
+   see the effects of the memory hierarchy, and several runs to see how much
+   the results vary from one run to the next.
+ */
+
+#include <stdio.h>          /* printf(), fprintf(), fopen(), fread() */
+#include <stdlib.h>         /* malloc(), realloc(), free(), atoi(), strtol() */
+#include <string.h>         /* memcmp() */
+#include <limits.h>         /* UINT_MAX */
+#include <time.h>           /* clock(), CLOCKS_PER_SEC */
+#include "zlib.h"
+
+#define local static
+
+/* largest piece of data that a z_stream can take at once */
+#define PIECE (chunk && chunk < UINT_MAX ? chunk : UINT_MAX)
+
+/* parameters of the tests, from the command line */
+local int lo = 6, hi = 9;   /* range of levels */
+local int runs = 3;         /* number of runs at each level */
+local int wbits = 15;       /* windowBits */
+local int mlevel = 8;       /* memLevel */
+local unsigned long chunk = 0;  /* size of input and output chunks, 0: all */
+
+/* Compress len bytes at in to out, which has room for size bytes, at level.
+   Return the compressed length, or 0 on error. */
+local unsigned long comp(unsigned char *in, unsigned long len,
+                         unsigned char *out, unsigned long size, int level)
+{
+    int ret;
+    unsigned long left = len, room = size, n;
+    z_stream strm;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    if (deflateInit2(&strm, level, Z_DEFLATED, wbits, mlevel,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+    strm.next_in = in;
+    strm.next_out = out;
+    do {
+        n = PIECE;
+        strm.avail_in = (unsigned)(left < n ? left : n);
+        left -= strm.avail_in;
+        do {
+            strm.avail_out = (unsigned)(room < n ? room : n);
+            room -= strm.avail_out;
+            ret = deflate(&strm, left ? Z_NO_FLUSH : Z_FINISH);
+            room += strm.avail_out;
+        } while (ret == Z_OK && strm.avail_out == 0 && room);
+    } while (ret == Z_OK && left);
+    deflateEnd(&strm);
+    return ret == Z_STREAM_END ? size - room : 0;
+}
+
+/* Decompress len bytes at in to out, which must have room for exactly size
+   bytes.  Return 0 on success, or -1 on error. */
+local int decomp(unsigned char *in, unsigned long len,
+                 unsigned char *out, unsigned long size)
+{
+    int ret;
+    unsigned long left = len, room = size, n;
+    z_stream strm;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = Z_NULL;
+    strm.avail_in = 0;
+    if (inflateInit2(&strm, wbits) != Z_OK)
+        return -1;
+    strm.next_out = out;
+    do {
+        n = PIECE;
+        if (strm.avail_in == 0) {
+            strm.next_in = in + (len - left);
+            strm.avail_in = (unsigned)(left < n ? left : n);
+            left -= strm.avail_in;
+        }
+        strm.avail_out = (unsigned)(room < n ? room : n);
+        room -= strm.avail_out;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        room += strm.avail_out;
+    } while (ret == Z_OK && (room || strm.avail_in || left));
+    inflateEnd(&strm);
+    return ret == Z_STREAM_END && room == 0 ? 0 : -1;
+}
+
+/* Return speed in MB/s for len bytes processed in t clock ticks. */
+local double speed(unsigned long len, clock_t t)
+{
+    return t ? len / 1e6 / ((double)t / CLOCKS_PER_SEC) : 0;
+}
+
+/* Read the named file into memory and run the tests on it.  Return 0 on
+   success, or 1 on error. */
+local int bench(char *name)
+{
+    int ret, level, run;
+    unsigned long len = 0, size, clen = 0;
+    size_t got;
+    unsigned char *data, *mem, *comp_buf, *back;
+    clock_t t, best_c, best_d;
+    FILE *in;
+
+    /* read the file */
+    in = fopen(name, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "zbench: cannot open %s\n", name);
+        return 1;
+    }
+    size = 1UL << 20;
+    data = malloc(size);
+    while (data != NULL && (got = fread(data + len, 1, size - len, in)) > 0) {
+        len += got;
+        if (len == size) {
+            mem = realloc(data, size << 1);
+            if (mem == NULL)
+                free(data);
+            data = mem;
+            size <<= 1;
+        }
+    }
+    fclose(in);
+    size = compressBound(len);
+    comp_buf = malloc(size);
+    back = malloc(len ? len : 1);
+    if (data == NULL || comp_buf == NULL || back == NULL) {
+        fprintf(stderr, "zbench: out of memory for %s\n", name);
+        free(back);
+        free(comp_buf);
+        free(data);
+        return 1;
+    }
+
+    /* compress and decompress at each level, keeping the best times */
+    for (level = lo; level <= hi; level++) {
+        best_c = best_d = 0;
+        for (run = 0; run < runs; run++) {
+            t = clock();
+            clen = comp(data, len, comp_buf, size, level);
+            t = clock() - t;
+            if (clen == 0) {
+                fprintf(stderr, "zbench: deflate error on %s\n", name);
+                break;
+            }
+            if (run == 0 || t < best_c)
+                best_c = t;
+            t = clock();
+            ret = decomp(comp_buf, clen, back, len);
+            t = clock() - t;
+            if (ret || memcmp(back, data, len)) {
+                fprintf(stderr, "zbench: inflate mismatch on %s\n", name);
+                clen = 0;
+                break;
+            }
+            if (run == 0 || t < best_d)
+                best_d = t;
+        }
+        if (clen == 0)
+            break;
+        printf("%s level %d: %lu -> %lu (%.2f%%), deflate %.1f MB/s, "
+               "inflate %.1f MB/s\n", name, level, len, clen,
+               len ? 100. * clen / len : 0., speed(len, best_c),
+               speed(len, best_d));
+    }
+    free(back);
+    free(comp_buf);
+    free(data);
+    return clen == 0 && level <= hi;
+}
+
+/* Process the options, and then run the tests on each named file. */
+int main(int argc, char **argv)
+{
+    int ret = 0, bad = 0;
+    char *end;
+
+    for (argc--, argv++; argc && **argv == '-'; argc--, argv++) {
+        switch ((*argv)[1]) {
+        case 'l':
+            lo = hi = (int)strtol(*argv + 2, &end, 10);
+            if (*end == '-')
+                hi = atoi(end + 1);
+            break;
+        case 'r':   runs = atoi(*argv + 2);  break;
+        case 'w':   wbits = atoi(*argv + 2);  break;
+        case 'm':   mlevel = atoi(*argv + 2);  break;
+        case 's':   chunk = strtoul(*argv + 2, NULL, 10);  break;
+        default:    bad = 1;
+        }
+    }
+    if (bad || argc == 0 || runs < 1 || lo < 0 || hi < lo) {
+        fputs("usage: zbench [-lN[-M]] [-rN] [-wN] [-mN] [-sN] file ...\n",
+              stderr);
+        return 1;
+    }
+    for (; argc; argc--, argv++)
+        ret |= bench(*argv);
+    return ret;
+}
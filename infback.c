@@ -66,6 +66,10 @@ int stream_size;
     state->window = window;
     state->wnext = 0;
     state->whave = 0;
+    state->cnlen = 0;
+#ifdef MULTI_BITS
+    state->mcode = Z_NULL;
+#endif
     return Z_OK;
 }
 
@@ -120,6 +124,9 @@ struct inflate_state FAR *state;
     state->lenbits = 9;
     state->distcode = distfix;
     state->distbits = 5;
+#ifdef MULTI_BITS
+    state->havemulti = 0;
+#endif
 }
 
 /* Macros for inflateBack(): */
@@ -164,6 +171,7 @@ struct inflate_state FAR *state;
                 ret = Z_BUF_ERROR; \
                 goto inf_leave; \
             } \
+            got += have; \
         } \
     } while (0)
 
@@ -258,6 +266,7 @@ void FAR *out_desc;
     z_const unsigned char FAR *next;    /* next input */
     unsigned char FAR *put;     /* next output */
     unsigned have, left;        /* available input and output */
+    unsigned long got;          /* total input from in() */
     unsigned long hold;         /* bit buffer */
     unsigned bits;              /* bits in bit buffer */
     unsigned copy;              /* number of stored or match bytes to copy */
@@ -285,6 +294,10 @@ void FAR *out_desc;
     bits = 0;
     put = state->window;
     left = state->wsize;
+    got = have;
+#ifdef MULTI_BITS
+    state->mlast = 0;
+#endif
 
     /* Inflate until end of block marked as last */
     for (;;)
@@ -382,7 +395,7 @@ void FAR *out_desc;
             }
             while (state->have < 19)
                 state->lens[order[state->have++]] = 0;
-            state->next = state->codes;
+            state->next = state->codes + ENOUGH;
             state->lencode = (code const FAR *)(state->next);
             state->lenbits = 7;
             ret = inflate_table(CODES, state->lens, 19, &(state->next),
@@ -453,9 +466,36 @@ void FAR *out_desc;
                 break;
             }
 
+            /* reuse the last dynamic code tables if they were built from the
+               same code lengths, as they are when an encoder repeats a block
+               header */
+            if (state->nlen == state->cnlen && state->ndist == state->cndist &&
+                zmemcmp((Bytef *)state->lens, (Bytef *)state->clens,
+                        (state->nlen + state->ndist) *
+                        sizeof(unsigned short)) == 0) {
+                state->lencode = (code const FAR *)(state->codes);
+                state->lenbits = state->clenbits;
+                state->distcode =
+                    (code const FAR *)(state->codes + state->cdist);
+                state->distbits = state->cdistbits;
+                state->next = state->codes + state->cused;
+#ifdef MULTI_BITS
+                if (!state->cmulti)
+                    state->cmulti = got - have - state->mlast >= MULTI_SPAN &&
+                        inflate_multi(strm, state->lencode, state->lenbits,
+                                      &(state->mcode));
+                state->havemulti = state->cmulti;
+                state->mlast = got - have;
+#endif
+                Tracev((stderr, "inflate:       codes reused\n"));
+                state->mode = LEN;
+                break;
+            }
+
             /* build code tables -- note: do not change the lenbits or distbits
                values here (9 and 6) without reading the comments in inftrees.h
                concerning the ENOUGH constants, which depend on those values */
+            state->cnlen = 0;
             state->next = state->codes;
             state->lencode = (code const FAR *)(state->next);
             state->lenbits = 9;
@@ -475,12 +515,29 @@ void FAR *out_desc;
                 state->mode = BAD;
                 break;
             }
+#ifdef MULTI_BITS
+            /* build the multiple literal table if the last block was long */
+            state->havemulti = got - have - state->mlast >= MULTI_SPAN &&
+                inflate_multi(strm, state->lencode, state->lenbits,
+                              &(state->mcode));
+            state->mlast = got - have;
+            state->cmulti = state->havemulti;
+#endif
+            zmemcpy((Bytef *)state->clens, (Bytef *)state->lens,
+                    (state->nlen + state->ndist) * sizeof(unsigned short));
+            state->cnlen = state->nlen;
+            state->cndist = state->ndist;
+            state->clenbits = state->lenbits;
+            state->cdistbits = state->distbits;
+            state->cdist = (unsigned)(state->distcode - state->codes);
+            state->cused = (unsigned)(state->next - state->codes);
             Tracev((stderr, "inflate:       codes ok\n"));
             state->mode = LEN;
 
         case LEN:
             /* use inflate_fast() if we have enough input and output */
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_HAVE &&
+                left >= INFLATE_FAST_MIN_LEFT) {
                 RESTORE();
                 if (state->whave < state->wsize)
                     state->whave = state->wsize - left;
@@ -631,8 +688,16 @@ void FAR *out_desc;
 int ZEXPORT inflateBackEnd(strm)
 z_streamp strm;
 {
+#ifdef MULTI_BITS
+    struct inflate_state FAR *state;
+#endif
+
     if (strm == Z_NULL || strm->state == Z_NULL || strm->zfree == (free_func)0)
         return Z_STREAM_ERROR;
+#ifdef MULTI_BITS
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->mcode != Z_NULL) ZFREE(strm, state->mcode);
+#endif
     ZFREE(strm, strm->state);
     strm->state = Z_NULL;
     Tracev((stderr, "inflate: end\n"));
@@ -12,6 +12,105 @@
 #  pragma message("Assembler code may have bugs -- use at your own risk")
 #else
 
+#ifdef BIT64
+/* Return the eight bytes at p as a little-endian 64-bit integer. */
+local BIT64 load64 OF((z_const unsigned char FAR *p));
+local BIT64 load64(p)
+z_const unsigned char FAR *p;
+{
+    BIT64 w;
+#  if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+      || defined(_WIN64)
+    zmemcpy((Bytef *)&w, (Bytef *)p, 8);
+#  else
+    int n;
+
+    w = 0;
+    for (n = 7; n >= 0; n--)
+        w = (w << 8) + p[n];
+#  endif
+    return w;
+}
+#endif
+
+#ifdef INFLATE_CHUNK
+/* Copy one chunk from from to out through a temporary, so that the two may
+   overlap.  Compilers turn this into a load and a store. */
+#define CHUNK(out, from) \
+    do { \
+        unsigned char chunk[INFLATE_CHUNK]; \
+        zmemcpy(chunk, from, INFLATE_CHUNK); \
+        zmemcpy(out, chunk, INFLATE_CHUNK); \
+    } while (0)
+
+/* Copy len bytes from from to out a chunk at a time, and return out + len.
+   from must not be in the INFLATE_CHUNK bytes before out, so that each chunk
+   read has already been written.  If over is true, then the last chunk is
+   copied whole, reading and writing up to INFLATE_CHUNK - 1 bytes past the
+   ends of the copy.  Otherwise the last bytes are copied one at a time. */
+local unsigned char FAR *chunk_copy OF((unsigned char FAR *out,
+                                        unsigned char FAR *from, unsigned len,
+                                        int over));
+local unsigned char FAR *chunk_copy(out, from, len, over)
+unsigned char FAR *out;
+unsigned char FAR *from;
+unsigned len;
+int over;
+{
+    while (len >= INFLATE_CHUNK) {
+        CHUNK(out, from);
+        out += INFLATE_CHUNK;
+        from += INFLATE_CHUNK;
+        len -= INFLATE_CHUNK;
+    }
+    if (len) {
+        if (over) {
+            CHUNK(out, from);
+            out += len;
+        }
+        else
+            do {
+                *out++ = *from++;
+            } while (--len);
+    }
+    return out;
+}
+
+/* Copy the len bytes that start dist bytes back from out to out, and return
+   out + len.  If dist is less than a chunk, the first chunk is copied a byte
+   at a time, which repeats the pattern, and the rest is copied from the
+   multiple of dist bytes back that is at least a chunk. */
+local unsigned char FAR *chunk_repeat OF((unsigned char FAR *out,
+                                          unsigned dist, unsigned len,
+                                          int over));
+local unsigned char FAR *chunk_repeat(out, dist, len, over)
+unsigned char FAR *out;
+unsigned dist;
+unsigned len;
+int over;
+{
+    unsigned char FAR *from;
+    unsigned n;
+
+    from = out - dist;
+    if (dist < INFLATE_CHUNK) {
+        n = len < INFLATE_CHUNK ? len : INFLATE_CHUNK;
+        len -= n;
+        do {
+            *out++ = *from++;
+        } while (--n);
+        if (len == 0)
+            return out;
+        n = dist;
+        do {
+            n += dist;
+        } while (n < INFLATE_CHUNK);
+        from = out - n;
+    }
+    return chunk_copy(out, from, len, over);
+}
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -23,8 +122,8 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_HAVE (6, or 8 with BIT64)
+        strm->avail_out >= INFLATE_FAST_MIN_LEFT (258, plus INFLATE_CHUNK - 1)
         start >= strm->avail_out
         state->bits < 8
 
@@ -42,10 +141,41 @@
       Therefore if strm->avail_in >= 6, then there is enough input to avoid
       checking for available input while decoding.
 
+    - With a 64-bit bit buffer, eight input bytes are loaded at once at the
+      start of each loop, which leaves 56 to 63 bits in hold -- enough for a
+      whole length/distance pair, so no other refills are needed.  in is only
+      advanced past the bytes that fit entirely.  The bits above bits in hold
+      are the start of the next byte, which the next load puts there again.
+      This needs eight bytes of input at the start of each loop instead of
+      six.
+
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
       output space.
+
+    - For a dynamic block, the multiple literal table mcode is tried first.
+      One lookup there decodes up to three literals whose codes fit in
+      MULTI_BITS bits.  The refill at the top of the loop always leaves at
+      least that many bits.  Three bytes are written even when fewer
+      literals are decoded, and the extra bytes are written over later,
+      except for inflateBack() as noted below for INFLATE_CHUNK.
+
+    - With INFLATE_CHUNK defined, matches are copied a chunk at a time, and
+      the last chunk may be written past the end of the match.  That needs
+      INFLATE_CHUNK - 1 more bytes of output space.  Those bytes are later
+      written over by the rest of the output, or else they are past the end
+      of what inflate() returns.  However for inflateBack(), the output is
+      the window itself, and the bytes after out are the oldest history,
+      which a later match can still copy.  Then the last bytes of a match
+      are copied one at a time.  Bytes copied from the window are never
+      read past the end of the match, since that could be past the end of
+      the window.
+
+    - After inflateDirect(), inflate() keeps no window.  wsize is zero, and
+      whave is instead the number of bytes of output from earlier inflate()
+      calls, which are still in place just before beg.  A distance that
+      reaches no further back than that is copied from the output.
  */
 void ZLIB_INTERNAL inflate_fast(strm, start)
 z_streamp strm;
@@ -64,26 +194,37 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     unsigned whave;             /* valid bytes in the window */
     unsigned wnext;             /* window write index */
     unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+#ifdef BIT64
+    BIT64 hold;                 /* local strm->hold */
+#else
     unsigned long hold;         /* local strm->hold */
+#endif
     unsigned bits;              /* local strm->bits */
     code const FAR *lcode;      /* local strm->lencode */
     code const FAR *dcode;      /* local strm->distcode */
     unsigned lmask;             /* mask for first level of length codes */
     unsigned dmask;             /* mask for first level of distance codes */
+#ifdef MULTI_BITS
+    multi const FAR *mcode;     /* local state->mcode, or Z_NULL */
+    multi lits;                 /* retrieved multiple literal entry */
+#endif
     code here;                  /* retrieved table entry */
     unsigned op;                /* code bits, operation, extra bits, or */
                                 /*  window position, window bytes to copy */
     unsigned len;               /* match length, unused bytes */
     unsigned dist;              /* match distance */
     unsigned char FAR *from;    /* where to copy match from */
+#if defined(INFLATE_CHUNK) || defined(MULTI_BITS)
+    int over;                   /* true to allow writes past the output */
+#endif
 
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
     in = strm->next_in;
-    last = in + (strm->avail_in - 5);
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_HAVE - 1));
     out = strm->next_out;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_LEFT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -97,17 +238,57 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     dcode = state->distcode;
     lmask = (1U << state->lenbits) - 1;
     dmask = (1U << state->distbits) - 1;
+#ifdef MULTI_BITS
+    mcode = state->havemulti ? state->mcode : Z_NULL;
+#endif
+#if defined(INFLATE_CHUNK) || defined(MULTI_BITS)
+    over = beg != window;
+#endif
 
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
+#ifdef BIT64
+        hold |= load64(in) << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
+#else
         if (bits < 15) {
             hold += (unsigned long)(*in++) << bits;
             bits += 8;
             hold += (unsigned long)(*in++) << bits;
             bits += 8;
         }
-        here = lcode[hold & lmask];
+#endif
+#ifdef MULTI_BITS
+        if (mcode != Z_NULL) {
+            lits = mcode[hold & ((1U << MULTI_BITS) - 1)];
+            if (lits.op & 3) {                  /* one to three literals */
+                Tracevv((stderr, "inflate:         %u literals\n",
+                        lits.op & 3));
+                op = (unsigned)(lits.op >> 2);
+                hold >>= op;
+                bits -= op;
+                if (over) {
+                    out[0] = lits.lit[0];
+                    out[1] = lits.lit[1];
+                    out[2] = lits.lit[2];
+                    out += lits.op & 3;
+                }
+                else {
+                    len = lits.op & 3;
+                    from = lits.lit;
+                    do {
+                        *out++ = *from++;
+                    } while (--len);
+                }
+                continue;
+            }
+            here = lits.here;
+        }
+        else
+#endif
+            here = lcode[hold & lmask];
       dolen:
         op = (unsigned)(here.bits);
         hold >>= op;
@@ -123,21 +304,25 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
             len = (unsigned)(here.val);
             op &= 15;                           /* number of extra bits */
             if (op) {
+#ifndef BIT64
                 if (bits < op) {
                     hold += (unsigned long)(*in++) << bits;
                     bits += 8;
                 }
+#endif
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
+#ifndef BIT64
             if (bits < 15) {
                 hold += (unsigned long)(*in++) << bits;
                 bits += 8;
                 hold += (unsigned long)(*in++) << bits;
                 bits += 8;
             }
+#endif
             here = dcode[hold & dmask];
           dodist:
             op = (unsigned)(here.bits);
@@ -147,6 +332,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(here.val);
                 op &= 15;                       /* number of extra bits */
+#ifndef BIT64
                 if (bits < op) {
                     hold += (unsigned long)(*in++) << bits;
                     bits += 8;
@@ -155,6 +341,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         bits += 8;
                     }
                 }
+#endif
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -167,7 +354,8 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                 bits -= op;
                 Tracevv((stderr, "inflate:         distance %u\n", dist));
                 op = (unsigned)(out - beg);     /* max distance in output */
-                if (dist > op) {                /* see if copy from window */
+                if (dist > op && (wsize || dist - op > whave)) {
+                                                /* see if copy from window */
                     op = dist - op;             /* distance back in window */
                     if (op > whave) {
                         if (state->sane) {
@@ -187,7 +375,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         do {
                             *out++ = 0;
                         } while (--op > whave);
-                        if (op == 0) {
+                        if (op == 0 || wsize == 0) {
                             from = out - dist;
                             do {
                                 *out++ = *from++;
@@ -196,6 +384,34 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         }
 #endif
                     }
+#ifdef INFLATE_CHUNK
+                    from = window;
+                    if (wnext == 0)             /* very common case */
+                        from += wsize - op;
+                    else if (wnext < op) {      /* wrap around window */
+                        from += wsize + wnext - op;
+                        op -= wnext;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            out = chunk_copy(out, from, op, 0);
+                            from = window;      /* then from start */
+                            op = wnext;
+                        }
+                    }
+                    else                        /* contiguous in window */
+                        from += wnext - op;
+                    if (op < len) {             /* some from window */
+                        len -= op;
+                        out = chunk_copy(out, from, op, 0);
+                        /* rest from output */
+                        out = chunk_repeat(out, dist, len, over);
+                    }
+                    else
+                        out = chunk_copy(out, from, len, 0);
+                }
+                else                            /* copy direct from output */
+                    out = chunk_repeat(out, dist, len, over);
+#else
                     from = window;
                     if (wnext == 0) {           /* very common case */
                         from += wsize - op;
@@ -262,6 +478,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                             *out++ = *from++;
                     }
                 }
+#endif
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
                 here = dcode[here.val + (hold & ((1U << op) - 1))];
@@ -298,10 +515,13 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* update state and return */
     strm->next_in = in;
     strm->next_out = out;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ?
+                                (INFLATE_FAST_MIN_HAVE - 1) + (last - in) :
+                                (INFLATE_FAST_MIN_HAVE - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
-    state->hold = hold;
+                                 (INFLATE_FAST_MIN_LEFT - 1) + (end - out) :
+                                 (INFLATE_FAST_MIN_LEFT - 1) - (out - end));
+    state->hold = (unsigned long)hold;
     state->bits = bits;
     return;
 }
@@ -8,4 +8,31 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* INFLATE_CHUNK is the number of bytes that inflate_fast() copies at a time
+   for a match.  The last chunk can write up to INFLATE_CHUNK - 1 bytes past
+   the end of the match.  Compile with -DNO_CHUNK_COPY to copy a byte at a
+   time instead. */
+#if defined(HAVE_MEMCPY) && !defined(NO_CHUNK_COPY)
+#  ifdef __AVX2__
+#    define INFLATE_CHUNK 32
+#  else
+#    define INFLATE_CHUNK 16
+#  endif
+#endif
+
+/* inflate_fast() may be called only when at least INFLATE_FAST_MIN_HAVE bytes
+   of input and INFLATE_FAST_MIN_LEFT bytes of output are available.  With a
+   64-bit bit buffer, it reads eight input bytes at a time, and with chunk
+   copies it needs room for the bytes written past the end of a match. */
+#ifdef BIT64
+#  define INFLATE_FAST_MIN_HAVE 8
+#else
+#  define INFLATE_FAST_MIN_HAVE 6
+#endif
+#ifdef INFLATE_CHUNK
+#  define INFLATE_FAST_MIN_LEFT (258 + INFLATE_CHUNK - 1)
+#else
+#  define INFLATE_FAST_MIN_LEFT 258
+#endif
+
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
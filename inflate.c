@@ -84,6 +84,18 @@
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
+#include "cpu_features.h"
+
+#ifdef X86_CPU
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#    define FIRST_ONE(x) first_one(x)
+     local unsigned first_one OF((unsigned x));
+#  else
+#    define FIRST_ONE(x) ((unsigned)__builtin_ctz(x))
+#  endif
+#endif
 
 #ifdef MAKEFIXED
 #  ifndef BUILDFIXED
@@ -96,12 +108,20 @@ local int inflateStateCheck OF((z_streamp strm));
 local void fixedtables OF((struct inflate_state FAR *state));
 local int updatewindow OF((z_streamp strm, const unsigned char FAR *end,
                            unsigned copy));
+local unsigned savedlens OF((struct inflate_state FAR *state));
+local unsigned char FAR *putsaved OF((unsigned char FAR *next,
+                                      unsigned long val, int n));
+local unsigned long getsaved OF((const unsigned char FAR * FAR *next, int n));
 #ifdef BUILDFIXED
    void makefixed OF((void));
 #endif
 local unsigned syncsearch OF((unsigned FAR *have, const unsigned char FAR *buf,
                               unsigned len));
 
+/* permutation of code lengths in a dynamic block header */
+local const unsigned short order[19] =
+    {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
 local int inflateStateCheck(strm)
 z_streamp strm;
 {
@@ -135,6 +155,11 @@ z_streamp strm;
     state->hold = 0;
     state->bits = 0;
     state->lencode = state->distcode = state->next = state->codes;
+    state->cnlen = 0;
+#ifdef MULTI_BITS
+    state->havemulti = 0;
+    state->mlast = 0;
+#endif
     state->sane = 1;
     state->back = -1;
     Tracev((stderr, "inflate: reset\n"));
@@ -184,6 +209,7 @@ int windowBits;
     if (state->window != Z_NULL && state->wbits != (unsigned)windowBits) {
         ZFREE(strm, state->window);
         state->window = Z_NULL;
+        state->walloc = 0;
     }
 
     /* update state and reset the rest of it */
@@ -227,6 +253,15 @@ int stream_size;
     strm->state = (struct internal_state FAR *)state;
     state->strm = strm;
     state->window = Z_NULL;
+    state->walloc = 0;
+#ifdef MULTI_BITS
+    state->mcode = Z_NULL;
+#endif
+    state->direct = 0;
+    state->flags = 0;           /* defined values for inflateSave() */
+    state->check = 0;
+    state->length = state->offset = state->extra = state->was = 0;
+    state->ncode = state->nlen = state->ndist = state->have = 0;
     state->mode = HEAD;     /* to pass state test in inflateReset2() */
     ret = inflateReset2(strm, windowBits);
     if (ret != Z_OK) {
@@ -316,6 +351,9 @@ struct inflate_state FAR *state;
     state->lenbits = 9;
     state->distcode = distfix;
     state->distbits = 5;
+#ifdef MULTI_BITS
+    state->havemulti = 0;
+#endif
 }
 
 #ifdef MAKEFIXED
@@ -387,6 +425,15 @@ void makefixed()
    It is also called to create a window for dictionary data when a dictionary
    is loaded.
 
+   The window starts at the smallest power of two, at least 256, that holds all
+   of the output so far, and is doubled as needed until it reaches 1 << wbits,
+   moving the history to the start of the new window in order.  So a short
+   stream, or one that is idle after a few short messages, uses a small window
+   instead of the full 32K.  Since the window grows before any history could
+   fall out of it, all of the history up to 1 << wbits is kept, as before.
+   After an inflateReset(), the window already allocated is reused at its
+   full size.
+
    Providing output buffers larger than 32K to inflate() should provide a speed
    advantage, since only the last 32K of output is copied to the sliding window
    upon return from inflate(), and since all distances after the first 32K of
@@ -399,24 +446,51 @@ const Bytef *end;
 unsigned copy;
 {
     struct inflate_state FAR *state;
-    unsigned dist;
+    unsigned dist, size, have;
+    unsigned char FAR *window;
 
     state = (struct inflate_state FAR *)strm->state;
 
-    /* if it hasn't been done already, allocate space for the window */
-    if (state->window == Z_NULL) {
-        state->window = (unsigned char FAR *)
-                        ZALLOC(strm, 1U << state->wbits,
-                               sizeof(unsigned char));
-        if (state->window == Z_NULL) return 1;
+    /* if the window can't hold the history with this output, replace it with
+       one large enough, copying over the history from oldest to newest */
+    have = state->wsize ? state->whave : 0;
+    size = 1U << state->wbits;
+    if (state->walloc < size && copy > state->walloc - have) {
+        dist = copy < size - have ? have + copy : size;
+        size = state->walloc ? state->walloc << 1 : 256;
+        while (size < dist)
+            size <<= 1;
+        if (have == 0 && state->window != Z_NULL) {
+            ZFREE(strm, state->window);     /* no history to keep */
+            state->window = Z_NULL;
+            state->walloc = 0;
+        }
+        window = (unsigned char FAR *)
+                 ZALLOC(strm, size, sizeof(unsigned char));
+        if (window == Z_NULL) return 1;
+        if (have) {
+            dist = have - state->wnext;
+            zmemcpy(window, state->window + state->wsize - dist, dist);
+            zmemcpy(window + dist, state->window, state->wnext);
+        }
+        if (state->window != Z_NULL)
+            ZFREE(strm, state->window);
+        state->window = window;
+        state->walloc = size;
+        if (state->wsize) {
+            state->wsize = size;
+            state->wnext = have;
+        }
     }
 
     /* if window not in use yet, initialize */
     if (state->wsize == 0) {
-        state->wsize = 1U << state->wbits;
+        state->wsize = state->walloc;
         state->wnext = 0;
         state->whave = 0;
     }
+    if (copy == 0)
+        return 0;
 
     /* copy state->wsize or less output bytes into the circular window */
     if (copy >= state->wsize) {
@@ -639,8 +713,6 @@ int flush;
 #ifdef GUNZIP
     unsigned char hbuf[4];      /* buffer for gzip header crc calculation */
 #endif
-    static const unsigned short order[19] = /* permutation of code lengths */
-        {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
     if (inflateStateCheck(strm) || strm->next_out == Z_NULL ||
         (strm->next_in == Z_NULL && strm->avail_in != 0))
@@ -943,7 +1015,7 @@ int flush;
             }
             while (state->have < 19)
                 state->lens[order[state->have++]] = 0;
-            state->next = state->codes;
+            state->next = state->codes + ENOUGH;
             state->lencode = (const code FAR *)(state->next);
             state->lenbits = 7;
             ret = inflate_table(CODES, state->lens, 19, &(state->next),
@@ -1014,9 +1086,38 @@ int flush;
                 break;
             }
 
+            /* reuse the last dynamic code tables if they were built from the
+               same code lengths, as they are when an encoder repeats a block
+               header */
+            if (state->nlen == state->cnlen && state->ndist == state->cndist &&
+                zmemcmp((Bytef *)state->lens, (Bytef *)state->clens,
+                        (state->nlen + state->ndist) *
+                        sizeof(unsigned short)) == 0) {
+                state->lencode = (const code FAR *)(state->codes);
+                state->lenbits = state->clenbits;
+                state->distcode =
+                    (const code FAR *)(state->codes + state->cdist);
+                state->distbits = state->cdistbits;
+                state->next = state->codes + state->cused;
+#ifdef MULTI_BITS
+                if (!state->cmulti)
+                    state->cmulti = strm->total_in + (in - have) -
+                                    state->mlast >= MULTI_SPAN &&
+                        inflate_multi(strm, state->lencode, state->lenbits,
+                                      &(state->mcode));
+                state->havemulti = state->cmulti;
+                state->mlast = strm->total_in + (in - have);
+#endif
+                Tracev((stderr, "inflate:       codes reused\n"));
+                state->mode = LEN_;
+                if (flush == Z_TREES) goto inf_leave;
+                break;
+            }
+
             /* build code tables -- note: do not change the lenbits or distbits
                values here (9 and 6) without reading the comments in inftrees.h
                concerning the ENOUGH constants, which depend on those values */
+            state->cnlen = 0;
             state->next = state->codes;
             state->lencode = (const code FAR *)(state->next);
             state->lenbits = 9;
@@ -1036,13 +1137,31 @@ int flush;
                 state->mode = BAD;
                 break;
             }
+#ifdef MULTI_BITS
+            /* build the multiple literal table if the last block was long */
+            state->havemulti =
+                strm->total_in + (in - have) - state->mlast >= MULTI_SPAN &&
+                inflate_multi(strm, state->lencode, state->lenbits,
+                              &(state->mcode));
+            state->mlast = strm->total_in + (in - have);
+            state->cmulti = state->havemulti;
+#endif
+            zmemcpy((Bytef *)state->clens, (Bytef *)state->lens,
+                    (state->nlen + state->ndist) * sizeof(unsigned short));
+            state->cnlen = state->nlen;
+            state->cndist = state->ndist;
+            state->clenbits = state->lenbits;
+            state->cdistbits = state->distbits;
+            state->cdist = (unsigned)(state->distcode - state->codes);
+            state->cused = (unsigned)(state->next - state->codes);
             Tracev((stderr, "inflate:       codes ok\n"));
             state->mode = LEN_;
             if (flush == Z_TREES) goto inf_leave;
         case LEN_:
             state->mode = LEN;
         case LEN:
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_HAVE &&
+                left >= INFLATE_FAST_MIN_LEFT) {
                 RESTORE();
                 inflate_fast(strm, out);
                 LOAD();
@@ -1146,7 +1265,9 @@ int flush;
         case MATCH:
             if (left == 0) goto inf_leave;
             copy = out - left;
-            if (state->offset > copy) {         /* copy from window */
+            if (state->offset > copy && (state->wsize ||
+                    state->offset - copy > state->whave)) {
+                                                /* copy from window */
                 copy = state->offset - copy;
                 if (copy > state->whave) {
                     if (state->sane) {
@@ -1252,7 +1373,14 @@ int flush;
      */
   inf_leave:
     RESTORE();
-    if (state->wsize || (out != strm->avail_out && state->mode < BAD &&
+    if (state->direct) {
+        /* the output stays in place to copy matches from, so just note how
+           much of it there is, up to the window size */
+        copy = out - strm->avail_out;
+        state->whave = copy < (1U << state->wbits) - state->whave ?
+                       state->whave + copy : 1U << state->wbits;
+    }
+    else if (state->wsize || (out != strm->avail_out && state->mode < BAD &&
             (state->mode < CHECK || flush != Z_FINISH)))
         if (updatewindow(strm, strm->next_out, out - strm->avail_out)) {
             state->mode = MEM;
@@ -1281,6 +1409,9 @@ z_streamp strm;
     if (inflateStateCheck(strm))
         return Z_STREAM_ERROR;
     state = (struct inflate_state FAR *)strm->state;
+#ifdef MULTI_BITS
+    if (state->mcode != Z_NULL) ZFREE(strm, state->mcode);
+#endif
     if (state->window != Z_NULL) ZFREE(strm, state->window);
     ZFREE(strm, strm->state);
     strm->state = Z_NULL;
@@ -1301,10 +1432,14 @@ uInt *dictLength;
 
     /* copy dictionary */
     if (state->whave && dictionary != Z_NULL) {
-        zmemcpy(dictionary, state->window + state->wnext,
-                state->whave - state->wnext);
-        zmemcpy(dictionary + state->whave - state->wnext,
-                state->window, state->wnext);
+        if (state->direct)
+            zmemcpy(dictionary, strm->next_out - state->whave, state->whave);
+        else {
+            zmemcpy(dictionary, state->window + state->wnext,
+                    state->whave - state->wnext);
+            zmemcpy(dictionary + state->whave - state->wnext,
+                    state->window, state->wnext);
+        }
     }
     if (dictLength != Z_NULL)
         *dictLength = state->whave;
@@ -1334,6 +1469,17 @@ uInt dictLength;
             return Z_DATA_ERROR;
     }
 
+    /* stop using the output in place of a window, copying what there is of
+       it to the window */
+    if (state->direct) {
+        if (state->whave &&
+                updatewindow(strm, strm->next_out, state->whave)) {
+            state->mode = MEM;
+            return Z_MEM_ERROR;
+        }
+        state->direct = 0;
+    }
+
     /* copy dictionary to window using updatewindow(), which will amend the
        existing dictionary if appropriate */
     ret = updatewindow(strm, dictionary + dictLength, dictLength);
@@ -1363,6 +1509,120 @@ gz_headerp head;
     return Z_OK;
 }
 
+/*
+   Return the offset in buf[0..len-1] of the first occurrence of the pattern
+   0, 0, 0xff, 0xff, or len - 3 if there is none, for len >= 3.  Any
+   occurrence covers exactly one byte at an offset that is 3 modulo 4, and
+   that byte is 0 or 0xff, which puts the occurrence at one of two offsets.
+   So the C version looks at only every fourth byte, with no dependence of
+   one load on another, and rarely has to look further.  These are the
+   syncscan kernels in z_kernels.
+ */
+#define SYNCAT(p) ((p) + 3 < len && buf[p] == 0 && buf[(p) + 1] == 0 && \
+                   buf[(p) + 2] == 0xff && buf[(p) + 3] == 0xff)
+
+z_size_t ZLIB_INTERNAL syncscan_c(buf, len)
+const unsigned char FAR *buf;
+z_size_t len;
+{
+    z_size_t next;
+    unsigned c;
+
+    for (next = 3; next < len; next += 4) {
+        c = buf[next];
+        if ((unsigned char)(c + 1) < 2) {
+            if (c) {
+                if (SYNCAT(next - 3)) return next - 3;
+                if (SYNCAT(next - 2)) return next - 2;
+            }
+            else {
+                if (SYNCAT(next - 1)) return next - 1;
+                if (SYNCAT(next)) return next;
+            }
+        }
+    }
+    return len - 3;
+}
+
+#ifdef X86_CPU
+#ifdef _MSC_VER
+/* Return the position of the least significant one bit in x != 0. */
+local unsigned first_one(x)
+unsigned x;
+{
+    unsigned long n;
+
+    _BitScanForward(&n, x);
+    return (unsigned)n;
+}
+#endif
+
+/* Test 16 positions at a time, getting a bit for each that starts the
+   pattern from the four comparisons of the bytes at offsets 0 to 3. */
+Z_TARGET("sse2")
+z_size_t ZLIB_INTERNAL syncscan_sse2(buf, len)
+const unsigned char FAR *buf;
+z_size_t len;
+{
+    z_size_t next;
+    unsigned hit;
+    __m128i zero, ones;
+
+    zero = _mm_setzero_si128();
+    ones = _mm_cmpeq_epi8(zero, zero);
+    next = 0;
+    while (len - next >= 16 + 3) {
+        hit = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128(
+                    (const __m128i *)(buf + next)), zero),
+                _mm_cmpeq_epi8(_mm_loadu_si128(
+                    (const __m128i *)(buf + next + 1)), zero)),
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128(
+                    (const __m128i *)(buf + next + 2)), ones),
+                _mm_cmpeq_epi8(_mm_loadu_si128(
+                    (const __m128i *)(buf + next + 3)), ones))));
+        if (hit)
+            return next + FIRST_ONE(hit);
+        next += 16;
+    }
+    return next + syncscan_c(buf + next, len - next);
+}
+
+/* Test 32 positions at a time. */
+Z_TARGET("avx2")
+z_size_t ZLIB_INTERNAL syncscan_avx2(buf, len)
+const unsigned char FAR *buf;
+z_size_t len;
+{
+    z_size_t next;
+    unsigned hit;
+    __m256i zero, ones;
+
+    zero = _mm256_setzero_si256();
+    ones = _mm256_cmpeq_epi8(zero, zero);
+    next = 0;
+    while (len - next >= 32 + 3) {
+        hit = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_and_si256(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                    (const __m256i *)(buf + next)), zero),
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                    (const __m256i *)(buf + next + 1)), zero)),
+            _mm256_and_si256(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                    (const __m256i *)(buf + next + 2)), ones),
+                _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                    (const __m256i *)(buf + next + 3)), ones))));
+        if (hit)
+            return next + FIRST_ONE(hit);
+        next += 32;
+    }
+    return next + syncscan_c(buf + next, len - next);
+}
+#endif /* X86_CPU */
+
 /*
    Search buf[0..len-1] for the pattern: 0, 0, 0xff, 0xff.  Return when found
    or when out of input.  When called, *have is the number of pattern bytes
@@ -1373,6 +1633,11 @@ gz_headerp head;
    yet and the return value is len.  In the latter case, syncsearch() can be
    called again with more data and the *have state.  *have is initialized to
    zero for the first call.
+
+   The state after a byte depends only on the last three bytes, so once three
+   bytes have been searched without finding the pattern, any pattern must be
+   entirely in buf.  syncscan() then goes right to the first one, or if there
+   is none, to the last three bytes to leave *have for the next call.
  */
 local unsigned syncsearch(have, buf, len)
 unsigned FAR *have;
@@ -1381,17 +1646,26 @@ unsigned len;
 {
     unsigned got;
     unsigned next;
+    unsigned last;
 
     got = *have;
     next = 0;
-    while (next < len && got < 4) {
-        if ((int)(buf[next]) == (got < 2 ? 0 : 0xff))
-            got++;
-        else if (buf[next])
-            got = 0;
-        else
-            got = 4 - got;
-        next++;
+    last = len < 64 ? len : 3;
+    for (;;) {
+        while (next < last && got < 4) {
+            if ((int)(buf[next]) == (got < 2 ? 0 : 0xff))
+                got++;
+            else if (buf[next])
+                got = 0;
+            else
+                got = 4 - got;
+            next++;
+        }
+        if (got == 4 || last == len)
+            break;
+        next = (unsigned)z_kernels.syncscan(buf, len);
+        got = 0;
+        last = len;
     }
     *have = got;
     return next;
@@ -1409,6 +1683,7 @@ z_streamp strm;
     if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
     state = (struct inflate_state FAR *)strm->state;
     if (strm->avail_in == 0 && state->bits < 8) return Z_BUF_ERROR;
+    z_cpu_check_features();
 
     /* if first time, start search in bit buffer */
     if (state->mode != SYNC) {
@@ -1440,6 +1715,31 @@ z_streamp strm;
     return Z_OK;
 }
 
+z_size_t ZEXPORT inflateSyncFind(buf, len, offsets, max)
+const Bytef *buf;
+z_size_t len;
+z_size_t *offsets;
+z_size_t max;
+{
+    z_size_t next, found;
+
+    if (buf == Z_NULL)
+        return 0;
+    z_cpu_check_features();
+    next = 0;
+    found = 0;
+    while (len - next >= 4) {
+        next += z_kernels.syncscan(buf + next, len - next);
+        if (len - next < 4)
+            break;
+        next += 4;
+        if (found < max && offsets != Z_NULL)
+            offsets[found] = next;
+        found++;
+    }
+    return found;
+}
+
 /*
    Returns true if inflate is currently at the end of a block generated by
    Z_SYNC_FLUSH or Z_FULL_FLUSH. This function is used by one PPP
@@ -1465,7 +1765,9 @@ z_streamp source;
     struct inflate_state FAR *state;
     struct inflate_state FAR *copy;
     unsigned char FAR *window;
-    unsigned wsize;
+#ifdef MULTI_BITS
+    multi FAR *mcode;
+#endif
 
     /* check input */
     if (inflateStateCheck(source) || dest == Z_NULL)
@@ -1479,32 +1781,358 @@ z_streamp source;
     window = Z_NULL;
     if (state->window != Z_NULL) {
         window = (unsigned char FAR *)
-                 ZALLOC(source, 1U << state->wbits, sizeof(unsigned char));
+                 ZALLOC(source, state->walloc, sizeof(unsigned char));
         if (window == Z_NULL) {
             ZFREE(source, copy);
             return Z_MEM_ERROR;
         }
     }
+#ifdef MULTI_BITS
+    mcode = Z_NULL;
+    if (state->mcode != Z_NULL) {
+        mcode = (multi FAR *)
+                ZALLOC(source, 1U << MULTI_BITS, sizeof(multi));
+        if (mcode == Z_NULL) {
+            if (window != Z_NULL) ZFREE(source, window);
+            ZFREE(source, copy);
+            return Z_MEM_ERROR;
+        }
+    }
+#endif
 
     /* copy state */
     zmemcpy((voidpf)dest, (voidpf)source, sizeof(z_stream));
     zmemcpy((voidpf)copy, (voidpf)state, sizeof(struct inflate_state));
     copy->strm = dest;
     if (state->lencode >= state->codes &&
-        state->lencode <= state->codes + ENOUGH - 1) {
+        state->lencode <= state->codes + ENOUGH + ENOUGH_CODES - 1) {
         copy->lencode = copy->codes + (state->lencode - state->codes);
         copy->distcode = copy->codes + (state->distcode - state->codes);
     }
     copy->next = copy->codes + (state->next - state->codes);
-    if (window != Z_NULL) {
-        wsize = 1U << state->wbits;
-        zmemcpy(window, state->window, wsize);
-    }
+    if (window != Z_NULL)
+        zmemcpy(window, state->window, state->walloc);
     copy->window = window;
+#ifdef MULTI_BITS
+    if (mcode != Z_NULL)
+        zmemcpy((voidpf)mcode, (voidpf)state->mcode,
+                (1U << MULTI_BITS) * sizeof(multi));
+    copy->mcode = mcode;
+#endif
     dest->state = (struct internal_state FAR *)copy;
     return Z_OK;
 }
 
+/* Return the number of code lengths to save for the mode of state. */
+local unsigned savedlens(state)
+struct inflate_state FAR *state;
+{
+    switch (state->mode) {
+    case LENLENS:
+        return state->have;
+    case CODELENS:
+        return 19 + state->have;
+    case LEN_:
+    case LEN:
+    case LENEXT:
+    case DIST:
+    case DISTEXT:
+    case MATCH:
+    case LIT:
+        return state->lencode >= state->codes &&
+               state->lencode <= state->codes + ENOUGH + ENOUGH_CODES - 1 ?
+               state->nlen + state->ndist : 0;
+    default:
+        return 0;
+    }
+}
+
+/* Write the low n bytes of val at next, and return the byte after them. */
+local unsigned char FAR *putsaved(next, val, n)
+unsigned char FAR *next;
+unsigned long val;
+int n;
+{
+    while (n--) {
+        *next++ = (unsigned char)val;
+        val >>= 8;
+    }
+    return next;
+}
+
+/* Read n bytes at *next as a value, and advance *next past them. */
+local unsigned long getsaved(next, n)
+const unsigned char FAR * FAR *next;
+int n;
+{
+    unsigned long val;
+    int k;
+
+    *next += n;
+    val = 0;
+    for (k = 1; k <= n; k++)
+        val = (val << 8) + (*next)[-k];
+    return val;
+}
+
+int ZEXPORT inflateSave(strm, buf, len)
+z_streamp strm;
+Bytef *buf;
+uInt *len;
+{
+    struct inflate_state FAR *state;
+    unsigned char FAR *next;
+    unsigned lens, n;
+    int tables;
+    code here;
+
+    /* check state and room */
+    if (inflateStateCheck(strm) || len == Z_NULL)
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    lens = savedlens(state);
+    if (buf == Z_NULL) {
+        *len = SAVED + state->whave + lens;
+        return Z_OK;
+    }
+    if (*len < SAVED + state->whave + lens)
+        return Z_BUF_ERROR;
+    *len = SAVED + state->whave + lens;
+
+    /* save state */
+    tables = 0;
+    if (state->mode >= LEN_ && state->mode <= LIT)
+        tables = lens ? 2 : 1;
+    next = buf;
+    next = putsaved(next, 1, 1);
+    next = putsaved(next, state->mode - HEAD, 1);
+    next = putsaved(next, state->wbits, 1);
+    next = putsaved(next, state->bits, 1);
+    next = putsaved(next, tables, 1);
+    next = putsaved(next, state->ncode, 1);
+    next = putsaved(next, state->ndist, 1);
+    next = putsaved(next, state->nlen, 2);
+    next = putsaved(next, state->have, 2);
+    next = putsaved(next, state->whave, 4);
+    next = putsaved(next, state->last, 1);
+    next = putsaved(next, state->wrap, 1);
+    next = putsaved(next, state->havedict, 1);
+    next = putsaved(next, state->sane, 1);
+#ifdef MULTI_BITS
+    next = putsaved(next, state->havemulti, 1);
+#else
+    next = putsaved(next, 0, 1);
+#endif
+    next = putsaved(next, (unsigned long)state->flags, 4);
+    next = putsaved(next, state->dmax, 4);
+    next = putsaved(next, state->check, 4);
+    next = putsaved(next, strm->adler, 4);
+    next = putsaved(next, state->length, 4);
+    next = putsaved(next, state->offset, 4);
+    next = putsaved(next, state->extra, 4);
+    next = putsaved(next, (unsigned long)state->back, 4);
+    next = putsaved(next, state->was, 4);
+    next = putsaved(next, state->hold, 8);
+    next = putsaved(next, state->total, 8);
+    next = putsaved(next, strm->total_in, 8);
+    next = putsaved(next, strm->total_out, 8);
+#ifdef MULTI_BITS
+    next = putsaved(next, state->mlast, 8);
+#else
+    next = putsaved(next, 0, 8);
+#endif
+
+    /* save history, in place of the window if direct */
+    inflateGetDictionary(strm, next, Z_NULL);
+    next += state->whave;
+
+    /* save code lengths -- the code length code lengths are recovered from
+       their table, which has an entry with each length for each code */
+    if (state->mode == LENLENS)
+        for (n = 0; n < state->have; n++)
+            *next++ = (unsigned char)state->lens[order[n]];
+    else if (lens) {
+        if (state->mode == CODELENS) {
+            zmemzero(next, 19);
+            for (n = 0; n < 1U << state->lenbits; n++) {
+                here = state->lencode[n];
+                if (here.op == 0)
+                    next[here.val] = here.bits;
+            }
+            next += 19;
+            lens -= 19;
+        }
+        for (n = 0; n < lens; n++)
+            *next++ = (unsigned char)state->lens[n];
+    }
+    return Z_OK;
+}
+
+int ZEXPORT inflateRestore(strm, buf, len)
+z_streamp strm;
+const Bytef *buf;
+uInt len;
+{
+    struct inflate_state FAR *state;
+    const unsigned char FAR *next;
+    unsigned mode, wbits, bits, tables, ncode, ndist, nlen, have, whave;
+    unsigned lens, n;
+    unsigned short clens[19];
+    unsigned long val;
+
+    /* check state and the image */
+    if (inflateStateCheck(strm) || buf == Z_NULL)
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if (len < SAVED || buf[0] != 1)
+        return Z_DATA_ERROR;
+    next = buf + 1;
+    mode = HEAD + (unsigned)getsaved(&next, 1);
+    wbits = (unsigned)getsaved(&next, 1);
+    bits = (unsigned)getsaved(&next, 1);
+    tables = (unsigned)getsaved(&next, 1);
+    ncode = (unsigned)getsaved(&next, 1);
+    ndist = (unsigned)getsaved(&next, 1);
+    nlen = (unsigned)getsaved(&next, 2);
+    have = (unsigned)getsaved(&next, 2);
+    whave = (unsigned)getsaved(&next, 4);
+    if (mode > SYNC || (wbits && (wbits < 8 || wbits > 15)) ||
+        whave > (wbits ? 1U << wbits : 0) ||
+        bits > 8 * sizeof(state->hold) ||
+        (mode >= LEN_ && mode <= LIT) != (tables != 0) || tables > 2 ||
+        (mode == LENLENS && (ncode > 19 || have > ncode)) ||
+        ((mode == CODELENS || tables == 2) && (nlen > 288 || ndist > 32)) ||
+        (mode == CODELENS && have > nlen + ndist) ||
+        (mode == SYNC && have > 4))
+        return Z_DATA_ERROR;
+    lens = mode == LENLENS ? have : mode == CODELENS ? 19 + have :
+           tables == 2 ? nlen + ndist : 0;
+    if (len != SAVED + whave + lens)
+        return Z_DATA_ERROR;
+    for (n = 0; n < lens; n++)
+        if (buf[SAVED + whave + n] > 15)
+            return Z_DATA_ERROR;
+
+    /* start over, with the saved window size -- the multiple literal table is
+       rebuilt below if the restored tables use it */
+#ifdef MULTI_BITS
+    if (state->mcode != Z_NULL) {
+        ZFREE(strm, state->mcode);
+        state->mcode = Z_NULL;
+    }
+#endif
+    if (state->window != Z_NULL && state->wbits != wbits) {
+        ZFREE(strm, state->window);
+        state->window = Z_NULL;
+        state->walloc = 0;
+    }
+    state->wbits = wbits;
+    state->direct = 0;
+    inflateReset(strm);
+
+    /* restore state */
+    state->bits = bits;
+    state->ncode = ncode;
+    state->ndist = ndist;
+    state->nlen = nlen;
+    state->have = have;
+    state->last = (int)getsaved(&next, 1);
+    state->wrap = (int)getsaved(&next, 1);
+    state->havedict = (int)getsaved(&next, 1);
+    state->sane = (int)getsaved(&next, 1);
+#ifdef MULTI_BITS
+    state->havemulti = (int)getsaved(&next, 1);
+#else
+    next++;
+#endif
+    state->flags = (int)getsaved(&next, 4);
+    state->dmax = (unsigned)getsaved(&next, 4);
+    state->check = getsaved(&next, 4);
+    strm->adler = getsaved(&next, 4);
+    state->length = (unsigned)getsaved(&next, 4);
+    state->offset = (unsigned)getsaved(&next, 4);
+    state->extra = (unsigned)getsaved(&next, 4);
+    if ((mode == LENEXT || mode == DISTEXT) && state->extra > 15) {
+        inflateReset(strm);
+        return Z_DATA_ERROR;
+    }
+    val = getsaved(&next, 4);
+    state->back = val > 0x7fffffffUL ? -1 : (int)val;
+    state->was = (unsigned)getsaved(&next, 4);
+    state->hold = getsaved(&next, 8);
+    state->total = getsaved(&next, 8);
+    strm->total_in = getsaved(&next, 8);
+    strm->total_out = getsaved(&next, 8);
+#ifdef MULTI_BITS
+    state->mlast = getsaved(&next, 8);
+#else
+    next += 8;
+#endif
+
+    /* restore history */
+    if (whave && updatewindow(strm, next + whave, whave)) {
+        inflateReset(strm);
+        return Z_MEM_ERROR;
+    }
+    next += whave;
+
+    /* rebuild code tables */
+    if (mode == LENLENS)
+        for (n = 0; n < have; n++)
+            state->lens[order[n]] = *next++;
+    else if (mode == CODELENS) {
+        for (n = 0; n < 19; n++)
+            clens[n] = *next++;
+        for (n = 0; n < have; n++)
+            state->lens[n] = *next++;
+        state->next = state->codes + ENOUGH;
+        state->lencode = (const code FAR *)(state->next);
+        state->lenbits = 7;
+        if (inflate_table(CODES, clens, 19, &(state->next),
+                          &(state->lenbits), state->work)) {
+            inflateReset(strm);
+            return Z_DATA_ERROR;
+        }
+    }
+    else if (tables == 1)
+        fixedtables(state);
+    else if (tables == 2) {
+        for (n = 0; n < lens; n++)
+            state->lens[n] = *next++;
+        state->next = state->codes;
+        state->lencode = (const code FAR *)(state->next);
+        state->lenbits = 9;
+        if (inflate_table(LENS, state->lens, nlen, &(state->next),
+                          &(state->lenbits), state->work)) {
+            inflateReset(strm);
+            return Z_DATA_ERROR;
+        }
+        state->distcode = (const code FAR *)(state->next);
+        state->distbits = 6;
+        if (inflate_table(DISTS, state->lens + nlen, ndist, &(state->next),
+                          &(state->distbits), state->work)) {
+            inflateReset(strm);
+            return Z_DATA_ERROR;
+        }
+#ifdef MULTI_BITS
+        if (state->havemulti)
+            state->havemulti = inflate_multi(strm, state->lencode,
+                                             state->lenbits, &(state->mcode));
+        state->cmulti = state->havemulti;
+#endif
+        zmemcpy((Bytef *)state->clens, (Bytef *)state->lens,
+                lens * sizeof(unsigned short));
+        state->cnlen = nlen;
+        state->cndist = ndist;
+        state->clenbits = state->lenbits;
+        state->cdistbits = state->distbits;
+        state->cdist = (unsigned)(state->distcode - state->codes);
+        state->cused = (unsigned)(state->next - state->codes);
+    }
+    state->mode = (inflate_mode)mode;
+    return Z_OK;
+}
+
 int ZEXPORT inflateUndermine(strm, subvert)
 z_streamp strm;
 int subvert;
@@ -1538,6 +2166,20 @@ int check;
     return Z_OK;
 }
 
+int ZEXPORT inflateDirect(strm, direct)
+z_streamp strm;
+int direct;
+{
+    struct inflate_state FAR *state;
+
+    if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->total || state->wsize)
+        return Z_STREAM_ERROR;
+    state->direct = direct != 0;
+    return Z_OK;
+}
+
 long ZEXPORT inflateMark(strm)
 z_streamp strm;
 {
@@ -94,9 +94,13 @@ struct inflate_state {
         /* sliding window */
     unsigned wbits;             /* log base 2 of requested window size */
     unsigned wsize;             /* window size or zero if not using window */
-    unsigned whave;             /* valid bytes in the window */
+    unsigned whave;             /* valid bytes in the window, or if direct,
+                                   valid output bytes before next_out */
     unsigned wnext;             /* window write index */
     unsigned char FAR *window;  /* allocated sliding window, if needed */
+    unsigned walloc;            /* allocated size of window, or zero */
+    int direct;                 /* true to copy matches from earlier output
+                                   in place instead of from a window */
         /* bit accumulator */
     unsigned long hold;         /* input bit accumulator */
     unsigned bits;              /* number of bits in "in" */
@@ -118,8 +122,39 @@ struct inflate_state {
     code FAR *next;             /* next available space in codes[] */
     unsigned short lens[320];   /* temporary storage for code lengths */
     unsigned short work[288];   /* work area for code table building */
-    code codes[ENOUGH];         /* space for code tables */
+    code codes[ENOUGH + ENOUGH_CODES];  /* space for code tables */
+        /* last dynamic code tables built in codes[], for reuse */
+    unsigned short clens[320];  /* code lengths of those tables */
+    unsigned cnlen;             /* number of length code lengths, 0 if none */
+    unsigned cndist;            /* number of distance code lengths */
+    unsigned clenbits;          /* index bits for the length/literal table */
+    unsigned cdistbits;         /* index bits for the distance table */
+    unsigned cdist;             /* offset of the distance table in codes[] */
+    unsigned cused;             /* number of codes[] entries used */
     int sane;                   /* if false, allow invalid distance too far */
     int back;                   /* bits back of last unprocessed length/lit */
     unsigned was;               /* initial length of match */
+#ifdef MULTI_BITS
+    int havemulti;              /* true if mcode[] is built from lencode */
+    unsigned long mlast;        /* total input at last dynamic block header */
+    int cmulti;                 /* havemulti for the last dynamic tables */
+    multi FAR *mcode;           /* multiple literal table, or Z_NULL */
+#endif
 };
+
+/*
+   An inflateSave() image is SAVED bytes of state, then the whave bytes of
+   history, oldest first, then any code lengths needed to rebuild the code
+   tables, one per byte.  Those are the have code length code lengths read so
+   far in LENLENS, in header order; the 19 code length code lengths by symbol
+   and then the have code lengths read so far in CODELENS; or the nlen + ndist
+   code lengths of the tables of a dynamic block.  The values in the state are
+   little-endian, and the layout is, by offset: 0 format (1 byte), 1 mode -
+   HEAD, 2 wbits, 3 bits, 4 tables (0 none, 1 fixed, 2 dynamic), 5 ncode,
+   6 ndist, 7 nlen (2 bytes), 9 have (2), 11 whave (4), 15 last (1), 16 wrap,
+   17 havedict, 18 sane, 19 havemulti, 20 flags (4), 24 dmax, 28 check,
+   32 strm->adler, 36 length, 40 offset, 44 extra, 48 back, 52 was, 56 hold
+   (8), 64 total, 72 strm->total_in, 80 strm->total_out, and 88 mlast.  There
+   are no pointers, so an image can be restored to any stream.
+ */
+#define SAVED 96
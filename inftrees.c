@@ -302,3 +302,120 @@ unsigned short FAR *work;
     *bits = root;
     return 0;
 }
+
+#ifdef MULTI_BITS
+/*
+   Build the multiple literal table from the length/literal table lcode, whose
+   root table has lenbits index bits.  Each entry starts as the root table
+   entry for its low bits, with no literals.  Then the entries that start
+   with the code for a literal get that literal, and the same is done for
+   each pair and then each triple of literals whose codes fit in MULTI_BITS
+   bits.  Only literals with codes in the root table are used.  They are put
+   in order of code length first, so that the search for the next literal can
+   stop at the first one that does not fit.
+
+   The table is only worth building if enough of it decodes two or more
+   literals.  Return 1 if the table was built, or 0 if fewer than one in
+   MULTI_MIN entries would have two or more literals, in which case the table
+   is left alone.  *mcode is allocated with strm's zalloc the first time the
+   table is built, and is freed when the stream ends.  0 is also returned if
+   that allocation fails, and then literals are decoded one at a time.
+ */
+#ifndef MULTI_MIN
+#  define MULTI_MIN 8
+#endif
+
+int ZLIB_INTERNAL inflate_multi(strm, lcode, lenbits, mcode)
+z_streamp strm;
+code const FAR *lcode;
+unsigned lenbits;
+multi FAR * FAR *mcode;
+{
+    unsigned len;               /* a code's length in bits */
+    unsigned root;              /* index in root table */
+    unsigned idx;               /* index in multiple literal table */
+    unsigned a, b, c;           /* first, second, and third literals */
+    unsigned drop2, drop3;      /* bits of first one or two codes */
+    unsigned len3;              /* bits of all three codes */
+    unsigned pairs;             /* entries with two or more literals */
+    unsigned short count[MAXBITS+1];    /* number of literals of each length */
+    unsigned short offs[MAXBITS+1];     /* offsets in lit[] for each length */
+    code lit[256];              /* literals, with bits and val, and their */
+    unsigned short huff[256];   /*  codes as indexed, ordered by length */
+    code here;                  /* root table entry */
+    multi FAR *table;           /* the table being built */
+
+    /* find the literals in the root table, and count them by length */
+    for (len = 0; len <= MAXBITS; len++)
+        count[len] = 0;
+    for (root = 0; root < 1U << lenbits; root++) {
+        here = lcode[root];
+        if (here.op == 0 && here.bits <= MULTI_BITS &&
+            root < 1U << here.bits)
+            count[here.bits]++;
+    }
+
+    /* see if enough of the table would decode two or more literals */
+    pairs = 0;
+    for (a = 1; a < MULTI_BITS; a++)
+        for (b = 1; a + b <= MULTI_BITS; b++)
+            pairs += ((unsigned)count[a] * count[b]) <<
+                     (MULTI_BITS - a - b);
+    if (pairs < (1U << MULTI_BITS) / MULTI_MIN)
+        return 0;
+    if (*mcode == Z_NULL) {
+        *mcode = (multi FAR *)ZALLOC(strm, 1U << MULTI_BITS, sizeof(multi));
+        if (*mcode == Z_NULL)
+            return 0;
+    }
+    table = *mcode;
+
+    /* sort the literals by length */
+    offs[1] = 0;
+    for (len = 1; len < MAXBITS; len++)
+        offs[len + 1] = offs[len] + count[len];
+    for (root = 0; root < 1U << lenbits; root++) {
+        here = lcode[root];
+        if (here.op == 0 && here.bits <= MULTI_BITS &&
+            root < 1U << here.bits) {
+            lit[offs[here.bits]] = here;
+            huff[offs[here.bits]++] = (unsigned short)root;
+        }
+    }
+    len = offs[MAXBITS];                /* number of literals */
+
+    /* start with the root table and no literals */
+    for (idx = 0; idx < 1U << MULTI_BITS; idx++) {
+        table[idx].here = lcode[idx & ((1U << lenbits) - 1)];
+        table[idx].op = 0;
+        table[idx].lit[0] = table[idx].lit[1] = table[idx].lit[2] = 0;
+    }
+
+    /* fill in the literals, then pairs, then triples */
+    for (a = 0; a < len; a++) {
+        drop2 = lit[a].bits;
+        for (idx = huff[a]; idx < 1U << MULTI_BITS; idx += 1U << drop2) {
+            table[idx].op = (unsigned char)((drop2 << 2) + 1);
+            table[idx].lit[0] = (unsigned char)lit[a].val;
+        }
+        for (b = 0; b < len && drop2 + lit[b].bits <= MULTI_BITS; b++) {
+            drop3 = drop2 + lit[b].bits;
+            for (idx = huff[a] + ((unsigned)huff[b] << drop2);
+                 idx < 1U << MULTI_BITS; idx += 1U << drop3) {
+                table[idx].op = (unsigned char)((drop3 << 2) + 2);
+                table[idx].lit[1] = (unsigned char)lit[b].val;
+            }
+            for (c = 0; c < len && drop3 + lit[c].bits <= MULTI_BITS; c++) {
+                len3 = drop3 + lit[c].bits;
+                for (idx = huff[a] + ((unsigned)huff[b] << drop2) +
+                           ((unsigned)huff[c] << drop3);
+                     idx < 1U << MULTI_BITS; idx += 1U << len3) {
+                    table[idx].op = (unsigned char)((len3 << 2) + 3);
+                    table[idx].lit[2] = (unsigned char)lit[c].val;
+                }
+            }
+        }
+    }
+    return 1;
+}
+#endif
@@ -50,6 +50,43 @@ typedef struct {
 #define ENOUGH_DISTS 592
 #define ENOUGH (ENOUGH_LENS+ENOUGH_DISTS)
 
+/* The code length code has at most seven-bit codes, and is decoded with a
+   root table of seven bits, so its table has at most 128 entries.  inflate()
+   and inflateBack() build it after the space for the other two tables, which
+   leaves those tables in place for reuse by the next dynamic block. */
+#define ENOUGH_CODES 128
+
+/* MULTI_BITS is the number of index bits of the table that inflate_fast()
+   uses to decode up to three literals with one lookup.  Compile with
+   -DNO_MULTI to decode one code per lookup instead. */
+#ifndef NO_MULTI
+#  define MULTI_BITS 11
+#endif
+
+/* inflate() and inflateBack() build the multiple literal table for a dynamic
+   block only if at least MULTI_SPAN bytes of input were used since the last
+   dynamic block header, taking the last block as a guess at this one.  The
+   table takes longer to build than it saves on a block with few literals, as
+   in a stream of small flushed messages. */
+#ifndef MULTI_SPAN
+#  define MULTI_SPAN 4096
+#endif
+
+/* Structure for the multiple literal table, which takes the place of the
+   root length/literal table.  It is indexed by the next MULTI_BITS bits of
+   input, and each entry has the literals whose codes are at the start of
+   those bits, up to three, as long as the codes fit in them.  The low two
+   bits of op are the number of literals, and the bits above those are the
+   total length of their codes.  The number of literals is zero if the first
+   code is not a literal in the root table or is longer than MULTI_BITS, in
+   which case here is the root table entry for the first code, to be used as
+   usual. */
+typedef struct {
+    code here;                  /* root table entry if no literals */
+    unsigned char op;           /* number of literals, code bits */
+    unsigned char lit[3];       /* the literals */
+} multi;
+
 /* Type of code to build for inflate_table() */
 typedef enum {
     CODES,
@@ -60,3 +97,8 @@ typedef enum {
 int ZLIB_INTERNAL inflate_table OF((codetype type, unsigned short FAR *lens,
                              unsigned codes, code FAR * FAR *table,
                              unsigned FAR *bits, unsigned short FAR *work));
+#ifdef MULTI_BITS
+int ZLIB_INTERNAL inflate_multi OF((z_streamp strm, code const FAR *lcode,
+                                    unsigned lenbits,
+                                    multi FAR * FAR *mcode));
+#endif
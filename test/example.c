@@ -47,6 +47,23 @@ void test_sync          OF((Byte *compr, uLong comprLen,
 void test_dict_deflate  OF((Byte *compr, uLong comprLen));
 void test_dict_inflate  OF((Byte *compr, uLong comprLen,
                             Byte *uncompr, uLong uncomprLen));
+uInt json_line          OF((char *buf, uLong id));
+Byte *json_data         OF((uLong size, uLong *len));
+void check_inflate      OF((Byte *compr, uLong comprLen,
+                            Byte *uncompr, uLong uncomprLen,
+                            Byte *data, uLong len, const char *what, int n));
+void test_hash          OF((Byte *compr, uLong comprLen,
+                            Byte *uncompr, uLong uncomprLen));
+void test_quick         OF((Byte *compr, uLong comprLen,
+                            Byte *uncompr, uLong uncomprLen));
+void test_match         OF((Byte *compr, uLong comprLen,
+                            Byte *uncompr, uLong uncomprLen));
+void test_optimal       OF((Byte *compr, uLong comprLen,
+                            Byte *uncompr, uLong uncomprLen));
+void test_in_place      OF((Byte *compr, uLong comprLen,
+                            Byte *uncompr, uLong uncomprLen));
+void test_save          OF((Byte *compr, uLong comprLen,
+                            Byte *uncompr, uLong uncomprLen));
 int  main               OF((int argc, char *argv[]));
 
 
@@ -538,6 +555,435 @@ void test_dict_inflate(compr, comprLen, uncompr, uncomprLen)
     }
 }
 
+/* ===========================================================================
+ * Write the JSON line with the given id to buf, and return its length
+ */
+uInt json_line(buf, id)
+    char *buf;
+    uLong id;
+{
+    sprintf(buf, "{\"id\":%lu,\"greeting\":\"%s\"}\n", id, hello);
+    return (uInt)strlen(buf);
+}
+
+/* ===========================================================================
+ * Allocate size bytes and fill them with JSON lines, leaving room for one
+ * more line, as test data for deflate(). Set *len to the length filled.
+ */
+Byte *json_data(size, len)
+    uLong size;
+    uLong *len;
+{
+    uLong n = 0;
+    Byte *data;
+
+    data = (Byte*)calloc((uInt)size, 1);
+    if (data == Z_NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+    *len = 0;
+    while (*len + 64 < size) {
+        *len += json_line((char*)data + *len, n * 7919 % 100003);
+        n++;
+    }
+    return data;
+}
+
+/* ===========================================================================
+ * Inflate the zlib stream in compr and check that it is the len bytes of
+ * data. what and n describe the stream for the error message.
+ */
+void check_inflate(compr, comprLen, uncompr, uncomprLen, data, len, what, n)
+    Byte *compr, *uncompr, *data;
+    uLong comprLen, uncomprLen, len;
+    const char *what;
+    int n;
+{
+    z_stream d_stream; /* decompression stream */
+    int err;
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+
+    d_stream.next_in = compr;
+    d_stream.avail_in = (uInt)comprLen;
+    d_stream.next_out = uncompr;
+    d_stream.avail_out = (uInt)uncomprLen;
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END || d_stream.total_out != len ||
+        memcmp(uncompr, data, (size_t)len)) {
+        fprintf(stderr, "bad inflate %s %d\n", what, n);
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+}
+
+/* ===========================================================================
+ * Test deflate() with each of the hash methods of deflateSetHash()
+ */
+void test_hash(compr, comprLen, uncompr, uncomprLen)
+    Byte *compr, *uncompr;
+    uLong comprLen, uncomprLen;
+{
+    z_stream c_stream; /* compression stream */
+    int err, method;
+    uLong len;
+    Byte *data;
+
+    data = json_data(uncomprLen, &len);
+    for (method = Z_HASH_DEFAULT; method <= Z_HASH_CRC32C; method++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+
+        err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+        CHECK_ERR(err, "deflateInit");
+        err = deflateSetHash(&c_stream, method);
+        CHECK_ERR(err, "deflateSetHash");
+        c_stream.next_out = Z_NULL;
+        c_stream.avail_out = 0;
+        err = deflateParams(&c_stream, Z_DEFAULT_COMPRESSION, Z_FILTERED);
+        CHECK_ERR(err, "deflateParams");
+        if (c_stream.total_out != 0) {
+            fprintf(stderr, "deflateParams should not write before input\n");
+            exit(1);
+        }
+
+        c_stream.next_in = data;
+        c_stream.avail_in = (uInt)len;
+        c_stream.next_out = compr;
+        c_stream.avail_out = (uInt)comprLen;
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        if (deflateSetHash(&c_stream, Z_HASH_DEFAULT) != Z_STREAM_ERROR) {
+            fprintf(stderr, "deflateSetHash should fail after input\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        check_inflate(compr, c_stream.total_out, uncompr, uncomprLen,
+                      data, len, "with hash method", method);
+    }
+    free(data);
+    printf("deflateSetHash(): OK\n");
+}
+
+/* ===========================================================================
+ * Test deflate() at level 1 with Z_FIXED, switching to it from level 2 with
+ * deflateParams()
+ */
+void test_quick(compr, comprLen, uncompr, uncomprLen)
+    Byte *compr, *uncompr;
+    uLong comprLen, uncomprLen;
+{
+    z_stream c_stream; /* compression stream */
+    int err, bits;
+    unsigned pending;
+    uLong len;
+    Byte *data;
+
+    data = json_data(uncomprLen, &len);
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit2(&c_stream, 2, Z_DEFLATED, MAX_WBITS, 8, Z_FIXED);
+    CHECK_ERR(err, "deflateInit2");
+
+    c_stream.next_in = data;
+    c_stream.avail_in = (uInt)len / 2;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    err = deflate(&c_stream, Z_NO_FLUSH);
+    CHECK_ERR(err, "deflate");
+    err = deflateParams(&c_stream, 1, Z_FIXED);
+    CHECK_ERR(err, "deflateParams");
+    c_stream.avail_in = (uInt)(len - len / 2);
+    err = deflate(&c_stream, Z_NO_FLUSH);
+    CHECK_ERR(err, "deflate");
+    err = deflatePending(&c_stream, &pending, &bits);
+    CHECK_ERR(err, "deflatePending");
+    if (bits < 0 || bits > 7 ||
+        c_stream.total_out + pending > comprLen) {
+        fprintf(stderr, "deflatePending: %u bytes %d bits\n", pending, bits);
+        exit(1);
+    }
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    check_inflate(compr, c_stream.total_out, uncompr, uncomprLen, data, len,
+                  "with Z_FIXED at level", 1);
+    free(data);
+    printf("deflate level 1 with Z_FIXED: OK\n");
+}
+
+/* ===========================================================================
+ * Test deflate() with each of the match finders of deflateSetMatch(),
+ * flushing partway and then switching to level 6, which always uses the hash
+ * chains. Z_MATCH_DEFAULT must give the same output as Z_MATCH_CHAIN.
+ */
+void test_match(compr, comprLen, uncompr, uncomprLen)
+    Byte *compr, *uncompr;
+    uLong comprLen, uncomprLen;
+{
+    z_stream c_stream; /* compression stream */
+    int err, method;
+    uLong len, size[Z_MATCH_TREE + 1];
+    Byte *data;
+
+    data = json_data(uncomprLen, &len);
+    for (method = Z_MATCH_DEFAULT; method <= Z_MATCH_TREE; method++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+
+        err = deflateInit(&c_stream, Z_BEST_COMPRESSION);
+        CHECK_ERR(err, "deflateInit");
+        err = deflateSetMatch(&c_stream, method);
+        CHECK_ERR(err, "deflateSetMatch");
+
+        c_stream.next_in = data;
+        c_stream.avail_in = (uInt)len / 2;
+        c_stream.next_out = compr;
+        c_stream.avail_out = (uInt)comprLen;
+        err = deflate(&c_stream, Z_SYNC_FLUSH);
+        CHECK_ERR(err, "deflate");
+        if (deflateSetMatch(&c_stream, Z_MATCH_DEFAULT) != Z_STREAM_ERROR) {
+            fprintf(stderr, "deflateSetMatch should fail after input\n");
+            exit(1);
+        }
+        err = deflateParams(&c_stream, 6, Z_DEFAULT_STRATEGY);
+        CHECK_ERR(err, "deflateParams");
+        c_stream.avail_in = (uInt)(len - len / 2);
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        size[method] = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        check_inflate(compr, c_stream.total_out, uncompr, uncomprLen,
+                      data, len, "with match method", method);
+    }
+    free(data);
+    if (size[Z_MATCH_DEFAULT] != size[Z_MATCH_CHAIN]) {
+        fprintf(stderr, "Z_MATCH_DEFAULT should use the hash chains\n");
+        exit(1);
+    }
+    printf("deflateSetMatch(): OK\n");
+}
+
+/* ===========================================================================
+ * Test deflate() with the optimal parsing of level 10, also switching to it
+ * with deflateParams(), against level 9
+ */
+void test_optimal(compr, comprLen, uncompr, uncomprLen)
+    Byte *compr, *uncompr;
+    uLong comprLen, uncomprLen;
+{
+    z_stream c_stream; /* compression stream */
+    int err, run;
+    uLong len, size[3];
+    Byte *data;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+    err = deflateInit(&c_stream, 11);
+    if (err != Z_STREAM_ERROR) {
+        fprintf(stderr, "deflateInit should reject level 11\n");
+        exit(1);
+    }
+
+    /* level 9, level 10, and level 9 then 10 for the second half */
+    data = json_data(uncomprLen, &len);
+    for (run = 0; run < 3; run++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+
+        err = deflateInit(&c_stream, run == 1 ? 10 : 9);
+        CHECK_ERR(err, "deflateInit");
+
+        c_stream.next_in = data;
+        c_stream.avail_in = (uInt)len / 2;
+        c_stream.next_out = compr;
+        c_stream.avail_out = (uInt)comprLen;
+        err = deflate(&c_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "deflate");
+        if (run == 2) {
+            err = deflateParams(&c_stream, 10, Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateParams");
+        }
+        c_stream.avail_in = (uInt)(len - len / 2);
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        size[run] = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        check_inflate(compr, c_stream.total_out, uncompr, uncomprLen,
+                      data, len, "in run", run);
+    }
+    free(data);
+    if (size[1] > size[0] || size[2] > size[0]) {
+        fprintf(stderr, "level 10 larger than level 9\n");
+        exit(1);
+    }
+    printf("deflate level 10: OK\n");
+}
+
+/* ===========================================================================
+ * Test a one-shot deflate() of more than a window of input, which compresses
+ * the input in place, with the output taken a little at a time
+ */
+void test_in_place(compr, comprLen, uncompr, uncomprLen)
+    Byte *compr, *uncompr;
+    uLong comprLen, uncomprLen;
+{
+    z_stream c_stream; /* compression stream */
+    int err, level;
+    uLong len;
+    Byte *data;
+
+    data = json_data(uncomprLen, &len);
+    for (level = 1; level <= 10; level += 3) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+
+        err = deflateInit2(&c_stream, level, Z_DEFLATED, 10, 8,
+                           Z_DEFAULT_STRATEGY);
+        CHECK_ERR(err, "deflateInit2");
+
+        c_stream.next_in = data;
+        c_stream.avail_in = (uInt)len;
+        c_stream.next_out = compr;
+        do {
+            if (c_stream.total_out >= comprLen) {
+                fprintf(stderr, "deflate output larger than %lu\n", comprLen);
+                exit(1);
+            }
+            c_stream.avail_out = comprLen - c_stream.total_out < 100 ?
+                                 (uInt)(comprLen - c_stream.total_out) : 100;
+            err = deflate(&c_stream, Z_FINISH);
+        } while (err == Z_OK);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        check_inflate(compr, c_stream.total_out, uncompr, uncomprLen,
+                      data, len, "at level", level);
+    }
+    free(data);
+    printf("one-shot deflate in place: OK\n");
+}
+
+/* ===========================================================================
+ * Test deflateSave() and deflateRestore() between messages of one raw deflate
+ * stream, each ended with a sync flush, ending the stream while it is saved
+ */
+void test_save(compr, comprLen, uncompr, uncomprLen)
+    Byte *compr, *uncompr;
+    uLong comprLen, uncomprLen;
+{
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+    int err, level, n;
+    uInt len;
+    uLong total = 0;
+    char msg[64];
+    Byte *saved;
+
+    saved = (Byte*)calloc(70000, 1);
+    if (saved == Z_NULL) {
+        printf("out of memory\n");
+        exit(1);
+    }
+    len = 0;
+    for (level = 1; level <= 10; level += 3) {
+        c_stream.next_out = compr;
+        for (n = 0; n < 100; n++) {
+            c_stream.zalloc = zalloc;
+            c_stream.zfree = zfree;
+            c_stream.opaque = (voidpf)0;
+
+            err = deflateInit2(&c_stream, level, Z_DEFLATED, -15, 8,
+                               Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateInit2");
+            if (n) {
+                err = deflateRestore(&c_stream, saved, len);
+                CHECK_ERR(err, "deflateRestore");
+            }
+
+            c_stream.next_in = (z_const unsigned char *)msg;
+            c_stream.avail_in = json_line(msg, (uLong)(n * 31 % 97));
+            c_stream.next_out = compr + total;
+            c_stream.avail_out = (uInt)(comprLen - total);
+            err = deflate(&c_stream, Z_SYNC_FLUSH);
+            CHECK_ERR(err, "deflate");
+            total = c_stream.total_out;
+
+            len = 70000;
+            err = deflateSave(&c_stream, saved, &len);
+            CHECK_ERR(err, "deflateSave");
+            deflateEnd(&c_stream);  /* Z_DATA_ERROR, since not finished */
+        }
+        if (total > 100 * 20) {
+            fprintf(stderr, "saved history not used at level %d\n", level);
+            exit(1);
+        }
+
+        d_stream.zalloc = zalloc;
+        d_stream.zfree = zfree;
+        d_stream.opaque = (voidpf)0;
+
+        err = inflateInit2(&d_stream, -15);
+        CHECK_ERR(err, "inflateInit2");
+
+        d_stream.next_in = compr;
+        d_stream.avail_in = (uInt)total;
+        d_stream.next_out = uncompr;
+        d_stream.avail_out = (uInt)uncomprLen;
+        err = inflate(&d_stream, Z_SYNC_FLUSH);
+        CHECK_ERR(err, "inflate");
+        n = (int)json_line(msg, 99 * 31 % 97);
+        if (d_stream.avail_in != 0 || d_stream.total_out < (uLong)n ||
+            memcmp(uncompr + d_stream.total_out - n, msg, (size_t)n)) {
+            fprintf(stderr, "bad inflate at level %d\n", level);
+            exit(1);
+        }
+        err = inflateEnd(&d_stream);
+        CHECK_ERR(err, "inflateEnd");
+        total = 0;
+    }
+    free(saved);
+    printf("deflateSave(): OK\n");
+}
+
 /* ===========================================================================
  * Usage:  example [output.gz  [input.gz]]
  */
@@ -595,6 +1041,13 @@ int main(argc, argv)
     test_dict_deflate(compr, comprLen);
     test_dict_inflate(compr, comprLen, uncompr, uncomprLen);
 
+    test_hash(compr, comprLen, uncompr, uncomprLen);
+    test_quick(compr, comprLen, uncompr, uncomprLen);
+    test_match(compr, comprLen, uncompr, uncomprLen);
+    test_optimal(compr, comprLen, uncompr, uncomprLen);
+    test_in_place(compr, comprLen, uncompr, uncomprLen);
+    test_save(compr, comprLen, uncompr, uncomprLen);
+
     free(compr);
     free(uncompr);
 
@@ -38,6 +38,9 @@
                             allocation failure (returns NULL) -- setting the
                             limit to zero means no limit, which is the default
                             after mem_setup()
+   mem_grow(&strm)          permits a block to be freed right after the one
+                            allocated to replace it, as when inflate grows its
+                            window and copies over the history
    mem_used(&strm, "msg")   prints to stderr "msg" and the total bytes used
    mem_high(&strm, "msg")   prints to stderr "msg" and the high water mark
    mem_done(&strm, "msg")   ends memory tracking, releases all allocations
@@ -65,6 +68,7 @@ struct mem_zone {
     size_t total, highwater;    /* total allocations, and largest total */
     size_t limit;               /* memory allocation limit, or 0 if no limit */
     int notlifo, rogue;         /* counts of non-LIFO frees and rogue frees */
+    int grow;                   /* true to permit replacement frees */
 };
 
 /* memory allocation routine to pass to zlib */
@@ -133,7 +137,8 @@ local void mem_free(void *mem, void *ptr)
             } while (next != NULL && next->ptr != ptr);
             if (next) {                 /* if found, remove from linked list */
                 item->next = next->next;
-                zone->notlifo++;        /* not a LIFO free */
+                if (!zone->grow || item != zone->first)
+                    zone->notlifo++;    /* not a LIFO free */
             }
 
         }
@@ -167,6 +172,7 @@ local void mem_setup(z_stream *strm)
     zone->limit = 0;
     zone->notlifo = 0;
     zone->rogue = 0;
+    zone->grow = 0;
     strm->opaque = zone;
     strm->zalloc = mem_alloc;
     strm->zfree = mem_free;
@@ -180,6 +186,14 @@ local void mem_limit(z_stream *strm, size_t limit)
     zone->limit = limit;
 }
 
+/* permit freeing a block just after allocating the one that replaces it */
+local void mem_grow(z_stream *strm)
+{
+    struct mem_zone *zone = strm->opaque;
+
+    zone->grow = 1;
+}
+
 /* show the current total requested allocations in bytes */
 local void mem_used(z_stream *strm, char *prefix)
 {
@@ -324,12 +338,9 @@ local void inf(char *hex, char *what, unsigned step, int win, unsigned len,
             ret = inflateSetDictionary(&strm, in, 1);
                                                 assert(ret == Z_DATA_ERROR);
             mem_limit(&strm, 1);
-            ret = inflateSetDictionary(&strm, out, 0);
-                                                assert(ret == Z_MEM_ERROR);
-            mem_limit(&strm, 0);
-            ((struct inflate_state *)strm.state)->mode = DICT;
             ret = inflateSetDictionary(&strm, out, 0);
                                                 assert(ret == Z_OK);
+            mem_limit(&strm, 0);
             ret = inflate(&strm, Z_NO_FLUSH);   assert(ret == Z_BUF_ERROR);
         }
         ret = inflateCopy(&copy, &strm);        assert(ret == Z_OK);
@@ -421,8 +432,10 @@ local void cover_wrap(void)
     mem_limit(&strm, 1);
     ret = inflate(&strm, Z_NO_FLUSH);           assert(ret == Z_MEM_ERROR);
     ret = inflate(&strm, Z_NO_FLUSH);           assert(ret == Z_MEM_ERROR);
-    mem_limit(&strm, 0);
     memset(dict, 0, 257);
+    ret = inflateSetDictionary(&strm, dict, 257);
+                                                assert(ret == Z_MEM_ERROR);
+    mem_limit(&strm, 0);
     ret = inflateSetDictionary(&strm, dict, 257);
                                                 assert(ret == Z_OK);
     mem_limit(&strm, (sizeof(struct inflate_state) << 1) + 256);
@@ -443,6 +456,35 @@ local void cover_wrap(void)
     mem_done(&strm, "miscellaneous, force memory errors");
 }
 
+/* cover growing the window with the output */
+local void cover_grow(void)
+{
+    int ret;
+    unsigned char out[1000];
+    z_stream strm;
+
+    mem_setup(&strm);
+    mem_grow(&strm);
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    ret = inflateInit(&strm);                   assert(ret == Z_OK);
+    strm.avail_in = 17;
+    strm.next_in = (void *)"\x78\x9c\x63\x60\x18\x5\xa3\x60\x14\xc\x77"
+                           "\0\0\x3\xe8\0\x1";
+    strm.next_out = out;
+    do {
+        strm.avail_out = 100;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        assert(((struct inflate_state *)strm.state)->walloc ==
+               (strm.total_out < 256 ? 256 : strm.total_out < 512 ? 512 :
+                1024));
+    } while (ret == Z_OK);
+                                                assert(ret == Z_STREAM_END);
+    assert(strm.total_out == 1000 && out[999] == 0);
+    ret = inflateEnd(&strm);                    assert(ret == Z_OK);
+    mem_done(&strm, "grow window");
+}
+
 /* input and output functions for inflateBack() */
 local unsigned pull(void *desc, unsigned char **buf)
 {
@@ -529,6 +571,7 @@ local int try(char *hex, char *id, int err)
     strcpy(prefix, id);
     strcat(prefix, "-late");
     mem_setup(&strm);
+    mem_grow(&strm);
     strm.avail_in = 0;
     strm.next_in = Z_NULL;
     ret = inflateInit2(&strm, err < 0 ? 47 : -15);
@@ -608,6 +651,12 @@ local void cover_inflate(void)
         "long distance and extra", 0);
     try("ed c0 81 0 0 0 0 80 a0 fd a9 17 a9 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 "
         "0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 6", "window end", 0);
+    try("4 c1 1 1 0 0 8 c3 a0 ac ec f6 cf 20 0 0 40 55 6d bb 7 0 0 ff ff 5 c1 "
+        "1 1 0 0 8 c3 a0 ac ec f6 cf 20 0 0 40 55 6d bb 7",
+        "reuse code tables", 0);
+    inf("4 c1 1 1 0 0 8 c3 a0 ac ec f6 cf 20 0 0 40 55 6d bb 7 0 0 ff ff 5 c1 "
+        "1 1 0 0 8 c3 a0 ac ec f6 cf 20 0 0 40 55 6d bb 7",
+        "reuse code tables", 0, -15, 258, Z_STREAM_END);
     inf("2 8 20 80 0 3 0", "inflate_fast TYPE return", 0, -15, 258,
         Z_STREAM_END);
     inf("63 18 5 40 c 0", "window wrap", 3, -8, 300, Z_OK);
@@ -637,25 +686,456 @@ local void cover_trees(void)
     fputs("inflate_table not enough errors\n", stderr);
 }
 
-/* cover remaining inffast.c decoding and window copying */
+/* accumulate the CRC-32 of the output at desc */
+local int push_crc(void *desc, unsigned char *buf, unsigned len)
+{
+    unsigned long *crc = desc;
+
+    *crc = crc32(*crc, buf, len);
+    return 0;
+}
+
+/* return the blocks in pre, if not NULL, which must end on a byte, then a
+   stored block of MULTI_SPAN zeros so that the multiple literal table is
+   built, then the stream in hex, setting *len to the total length */
+local unsigned char *span(char *pre, char *hex, unsigned *len)
+{
+    unsigned have, skip = 0;
+    unsigned char *in, *blk, *first = Z_NULL;
+
+    if (pre != NULL) {
+        first = h2b(pre, &skip);                assert(first != NULL);
+    }
+    blk = h2b(hex, &have);                      assert(blk != NULL);
+    in = malloc(skip + 5 + MULTI_SPAN + have);  assert(in != NULL);
+    if (skip)
+        memcpy(in, first, skip);
+    free(first);
+    in[skip] = 0;
+    in[skip + 1] = (unsigned char)MULTI_SPAN;
+    in[skip + 2] = (unsigned char)(MULTI_SPAN >> 8);
+    in[skip + 3] = (unsigned char)~in[skip + 1];
+    in[skip + 4] = (unsigned char)~in[skip + 2];
+    memset(in + skip + 5, 0, MULTI_SPAN);
+    memcpy(in + skip + 5 + MULTI_SPAN, blk, have);
+    free(blk);
+    *len = skip + 5 + MULTI_SPAN + have;
+    return in;
+}
+
+/* check the crc of the output of inflateBack() with a 1K window */
+local void back_crc(unsigned char *in, unsigned len, unsigned long check,
+                    char *what)
+{
+    int ret;
+    unsigned long crc = 0;
+    unsigned char win[1024];
+    z_stream strm;
+
+    mem_setup(&strm);
+    ret = inflateBackInit(&strm, 10, win);      assert(ret == Z_OK);
+    strm.avail_in = len;
+    strm.next_in = in;
+    ret = inflateBack(&strm, pull, Z_NULL, push_crc, &crc);
+                                                assert(ret == Z_STREAM_END);
+    assert(crc == check);
+    ret = inflateBackEnd(&strm);                assert(ret == Z_OK);
+    mem_done(&strm, what);
+}
+
+/* check the crc of the output of inflate() 1K at a time, with too little
+   memory for the multiple literal table if low, else copying the stream */
+local void inf_crc(unsigned char *in, unsigned len, unsigned long check,
+                   char *what, int low)
+{
+    int ret;
+    unsigned long crc = 0;
+    unsigned char out[1024];
+    z_stream strm, copy;
+
+    mem_setup(&strm);
+    ret = inflateInit2(&strm, -10);             assert(ret == Z_OK);
+    if (low)
+        mem_limit(&strm, sizeof(struct inflate_state) + 4096);
+    strm.avail_in = len;
+    strm.next_in = in;
+    do {
+        strm.avail_out = sizeof(out);
+        strm.next_out = out;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        assert(ret == Z_OK || ret == Z_STREAM_END);
+        crc = crc32(crc, out, sizeof(out) - strm.avail_out);
+    } while (ret == Z_OK);
+    assert(crc == check);
+    if (!low) {
+        ret = inflateCopy(&copy, &strm);        assert(ret == Z_OK);
+        ret = inflateEnd(&copy);                assert(ret == Z_OK);
+    }
+    inflateEnd(&strm);
+    mem_done(&strm, what);
+}
+
+/* check inflate_fast() with inflateBack() and inflate() on the stream in hex
+   after span() -- with inflateBack(), the bytes after a match are the oldest
+   in the window and must not be written over */
+local void fast_back(char *pre, char *hex, unsigned long check, char *what)
+{
+    unsigned len;
+    unsigned char *in;
+
+    in = span(pre, hex, &len);
+    back_crc(in, len, check, what);
+    inf_crc(in, len, check, what, 0);
+    inf_crc(in, len, check, what, 1);
+    free(in);
+}
+
+/* cover remaining inffast.c decoding and window copying -- inflate_fast() is
+   only used when there are at least INFLATE_FAST_MIN_HAVE bytes of input and
+   INFLATE_FAST_MIN_LEFT bytes of output available, so these streams are padded
+   with zeros and given 289 bytes of output */
 local void cover_fast(void)
 {
     inf("e5 e0 81 ad 6d cb b2 2c c9 01 1e 59 63 ae 7d ee fb 4d fd b5 35 41 68"
-        " ff 7f 0f 0 0 0", "fast length extra bits", 0, -8, 258, Z_DATA_ERROR);
+        " ff 7f 0f 0 0 0 0 0", "fast length extra bits", 0, -8, 289,
+        Z_DATA_ERROR);
     inf("25 fd 81 b5 6d 59 b6 6a 49 ea af 35 6 34 eb 8c b9 f6 b9 1e ef 67 49"
-        " 50 fe ff ff 3f 0 0", "fast distance extra bits", 0, -8, 258,
+        " 50 fe ff ff 3f 0 0 0 0", "fast distance extra bits", 0, -8, 289,
         Z_DATA_ERROR);
-    inf("3 7e 0 0 0 0 0", "fast invalid distance code", 0, -8, 258,
+    inf("3 7e 0 0 0 0 0 0 0", "fast invalid distance code", 0, -8, 289,
         Z_DATA_ERROR);
-    inf("1b 7 0 0 0 0 0", "fast invalid literal/length code", 0, -8, 258,
+    inf("1b 7 0 0 0 0 0 0 0", "fast invalid literal/length code", 0, -8, 289,
         Z_DATA_ERROR);
-    inf("d c7 1 ae eb 38 c 4 41 a0 87 72 de df fb 1f b8 36 b1 38 5d ff ff 0",
-        "fast 2nd level codes and too far back", 0, -8, 258, Z_DATA_ERROR);
-    inf("63 18 5 8c 10 8 0 0 0 0", "very common case", 0, -8, 259, Z_OK);
-    inf("63 60 60 18 c9 0 8 18 18 18 26 c0 28 0 29 0 0 0",
-        "contiguous and wrap around window", 6, -8, 259, Z_OK);
-    inf("63 0 3 0 0 0 0 0", "copy direct from output", 0, -8, 259,
+    inf("d c7 1 ae eb 38 c 4 41 a0 87 72 de df fb 1f b8 36 b1 38 5d ff ff 0 0"
+        " 0", "fast 2nd level codes and too far back", 0, -8, 289,
+        Z_DATA_ERROR);
+    inf("8b 22 e 8c ca 90 e0 39 0 0 0 0 0 0 0 0 0", "very common case", 0, -8,
+        289, Z_OK);
+    inf("13 23 11 8c f2 b2 7b f0 b8 3d 80 a0 2b 49 f6 76 13 b2 a e2 9c 4 0 0 0"
+        " 0 0 0 0 0 0", "contiguous and wrap around window", 11, -8, 289,
+        Z_OK);
+    inf("63 0 3 0 0 0 0 0 0 0", "copy direct from output", 0, -8, 289,
         Z_STREAM_END);
+    /* the second match copies from just past the end of the first one */
+    fast_back(Z_NULL,
+              "4b 4c 4a 1e 45 a3 68 14 8d 50 54 41 f 84 2d ef 3 0 0 0 0 0 0 0"
+              " 0 0", 0xe104d31f, "fast copy into window");
+    fast_back(Z_NULL,
+              "35 8f 81 11 80 30 c 2 67 d 84 fd 57 90 4f 4f ab a9 12 4a 5e 29"
+              " b3 d3 4b 3b e 2f d6 b8 db 89 d7 d0 e4 c9 aa 2e be 29 5a cd ee"
+              " 9 9e b8 e5 9d 58 a5 6b b1 61 f de e0 7f 33 a6 5e 32 f7 66 20"
+              " fa b2 79 76 b2 db dc 6b 16 86 76 e3 92 37 31 b4 90 72 d3 a9 e2"
+              " 14 f9 21 9c 89 25 89 7e fc 47 74 c1 e3 5 ff 70 1 16 77 b3 49"
+              " b4 1 ae e3 fa 1e 78 ed fe 50 41 c ab 5e fd 0",
+              0x88b52430, "fast multiple literals");
+    /* a literal is followed by a match that copies the byte after it from the
+       previous pass of the window */
+    fast_back(Z_NULL,
+              "ed f3 1 9 0 40 10 c3 30 68 6d 3b ff 1a ee 85 7c 3c 84 ef fb 3e"
+              " df ff f0 0 0 0 0 0 0 0 0 0", 0x4a532a61,
+              "fast multiple literals into window");
+    /* too few short literal codes to be worth building the table */
+    fast_back(Z_NULL,
+              "6d 50 b1 d c0 30 8 7b 85 3 10 3f 65 a8 d4 a5 73 d3 5e 5f 9 d4"
+              " d8 b1 58 ac 18 b0 71 98 cf 79 d9 fc c1 c7 7d bc 23 92 d7 33 d1"
+              " a5 47 d5 e4 e 3 48 79 5e 16 38 f4 d8 5d 2a c3 3c b8 89 3f 65"
+              " 68 f3 11 f7 c5 f9 57 bb 1f 8d 4b b1 d5 58 a7 de 6f 11 e2 18 72"
+              " aa ea 10 f6 e1 ed 3", 0xa0621495,
+              "fast few short literal codes");
+    /* the code tables of the first block are reused after MULTI_SPAN */
+    fast_back("4 c1 1 1 0 0 8 c3 a0 ac ec f6 cf 20 0 0 40 55 6d bb 7 0 0 ff"
+              " ff", "5 c1 1 1 0 0 8 c3 a0 ac ec f6 cf 20 0 0 40 55 6d bb 7",
+              0x83afedd4, "reuse code tables after span");
+}
+
+/* inflate() run with inflateDirect(), where hex is the raw deflate data, len
+   is the size of the output buffer, and err is the last return code
+   expected -- the output is allowed a few bytes at a time and then hundreds
+   at a time, so that matches are copied from the output of earlier calls
+   by both inflate() and inflate_fast(), and the crc of the output is then
+   compared to check */
+local void direct(char *hex, char *what, unsigned len, unsigned long check,
+                  int err)
+{
+    int ret;
+    unsigned have, next = 0, got;
+    unsigned char *in, *out, dict[32768];
+    z_stream strm;
+
+    mem_setup(&strm);
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    ret = inflateInit2(&strm, -15);             assert(ret == Z_OK);
+    ret = inflateDirect(&strm, 1);              assert(ret == Z_OK);
+    in = h2b(hex, &have);                       assert(in != NULL);
+    out = malloc(len);                          assert(out != NULL);
+    strm.avail_in = have;
+    strm.next_in = in;
+    strm.next_out = out;
+    do {
+        next++;
+        have = len - (unsigned)(strm.next_out - out);
+        strm.avail_out = have < (next & 1 ? 3 : 300) ? have :
+                         (next & 1 ? 3 : 300);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (next == 4) {
+            ret = inflateGetDictionary(&strm, dict, &got);
+                                                assert(ret == Z_OK);
+            assert(got == strm.total_out);
+            assert(memcmp(dict, out, got) == 0);
+            ret = Z_OK;
+        }
+    } while (ret == Z_OK && strm.avail_out == 0);
+    assert(ret == err);
+    assert(((struct inflate_state *)strm.state)->window == Z_NULL);
+    if (err == Z_STREAM_END)
+        assert(crc32(0, out, strm.total_out) == check);
+    ret = inflateDirect(&strm, 0);              assert(ret == Z_STREAM_ERROR);
+    ret = inflateEnd(&strm);                    assert(ret == Z_OK);
+    mem_done(&strm, what);
+    free(out);
+    free(in);
+}
+
+/* cover inflateDirect() */
+local void cover_direct(void)
+{
+    int ret;
+    unsigned got;
+    unsigned char out[16], dict[32];
+    z_stream strm;
+
+    ret = inflateDirect(Z_NULL, 1);             assert(ret == Z_STREAM_ERROR);
+    direct("4b 4c 4a 1e 45 a3 68 14 8d 50 54 41 f 84 2d ef 3 0", "direct",
+           1145, 0xa4d31a50, Z_STREAM_END);
+    direct("4b 4c 4a 6 62 0", "direct too far back", 300, 0, Z_DATA_ERROR);
+    direct("4b 4c 4a 6 62 0 0 0 0 0 0 0 0 0 0 0", "direct fast too far back",
+           300, 0, Z_DATA_ERROR);
+
+    /* a dictionary moves the earlier output to a window */
+    mem_setup(&strm);
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    ret = inflateInit2(&strm, -15);             assert(ret == Z_OK);
+    ret = inflateDirect(&strm, 1);              assert(ret == Z_OK);
+    strm.avail_in = 4;
+    strm.next_in = (void *)"\x63\x0\x3\x0";
+    strm.avail_out = sizeof(out);
+    strm.next_out = out;
+    ret = inflate(&strm, Z_NO_FLUSH);           assert(ret == Z_STREAM_END);
+    mem_limit(&strm, 1);
+    ret = inflateSetDictionary(&strm, out, 2);  assert(ret == Z_MEM_ERROR);
+    mem_limit(&strm, 0);
+    ret = inflateSetDictionary(&strm, out, 2);  assert(ret == Z_OK);
+    ret = inflateGetDictionary(&strm, dict, &got);
+                                                assert(ret == Z_OK);
+    assert(got == 8 && memcmp(dict, "\0\0\0\0\0\0\0\0", 8) == 0);
+    ret = inflateReset(&strm);                  assert(ret == Z_OK);
+    ret = inflateDirect(&strm, 1);              assert(ret == Z_OK);
+    ret = inflateSetDictionary(&strm, out, 2);  assert(ret == Z_OK);
+    ret = inflateDirect(&strm, 1);              assert(ret == Z_STREAM_ERROR);
+    ret = inflateEnd(&strm);                    assert(ret == Z_OK);
+    mem_done(&strm, "direct dictionary");
+}
+
+/* inflate() the gzip stream in hex one byte of input and output at a time,
+   saving the state with inflateSave() after each call and restoring it to the
+   other of two streams with inflateRestore(), so that the stream is resumed
+   from every mode -- the header is checked, and the crc of the output is
+   compared to check */
+local void save(char *hex, char *what, unsigned long check)
+{
+    int ret, cur = 0;
+    unsigned have;
+    uInt len;
+    unsigned char *in, out[512], buf[1024], name[4], extra[4], comment[4];
+    gz_header head;
+    z_stream strm[2];
+
+    mem_setup(&strm[0]);
+    mem_setup(&strm[1]);
+    mem_grow(&strm[0]);
+    mem_grow(&strm[1]);
+    strm[0].avail_in = strm[1].avail_in = 0;
+    strm[0].next_in = strm[1].next_in = Z_NULL;
+    ret = inflateInit2(&strm[0], 31);           assert(ret == Z_OK);
+    ret = inflateInit2(&strm[1], -9);           assert(ret == Z_OK);
+    head.extra = extra;
+    head.extra_max = sizeof(extra);
+    head.name = name;
+    head.name_max = sizeof(name);
+    head.comment = comment;
+    head.comm_max = sizeof(comment);
+    ret = inflateGetHeader(&strm[0], &head);    assert(ret == Z_OK);
+    in = h2b(hex, &have);                       assert(in != NULL);
+    strm[0].next_in = in;
+    strm[0].next_out = out;
+    do {
+        strm[cur].avail_in = have ? 1 : 0;
+        have -= strm[cur].avail_in;
+        strm[cur].avail_out = 1;
+        ret = inflate(&strm[cur], Z_NO_FLUSH);
+        assert(ret == Z_OK || ret == Z_BUF_ERROR || ret == Z_STREAM_END);
+        have += strm[cur].avail_in;
+        ret = inflateSave(&strm[cur], Z_NULL, &len);
+                                                assert(ret == Z_OK);
+        assert(len <= sizeof(buf));
+        ret = inflateSave(&strm[cur], buf, &len);
+                                                assert(ret == Z_OK);
+        ret = inflateRestore(&strm[1 - cur], buf, len);
+                                                assert(ret == Z_OK);
+        strm[1 - cur].next_in = strm[cur].next_in;
+        strm[1 - cur].next_out = strm[cur].next_out;
+        cur = 1 - cur;
+        if (!head.done) {
+            ret = inflateGetHeader(&strm[cur], &head);
+                                                assert(ret == Z_OK);
+        }
+        ret = inflate(&strm[cur], Z_NO_FLUSH);
+    } while (ret == Z_OK || ret == Z_BUF_ERROR);
+    assert(ret == Z_STREAM_END);
+    assert(head.done == 1 && head.extra_len == 2 &&
+           memcmp(extra, "xy", 2) == 0 && strcmp((char *)name, "n") == 0 &&
+           strcmp((char *)comment, "c") == 0);
+    assert(crc32(0, out, strm[cur].total_out) == check);
+    free(in);
+    ret = inflateEnd(&strm[0]);                 assert(ret == Z_OK);
+    ret = inflateEnd(&strm[1]);                 assert(ret == Z_OK);
+    mem_done(&strm[0], what);
+    mem_done(&strm[1], what);
+}
+
+/* cover inflateSave() and inflateRestore() */
+local void cover_save(void)
+{
+    int ret;
+    uInt len;
+    unsigned char buf[SAVED + 257];
+    z_stream strm;
+
+    ret = inflateSave(Z_NULL, Z_NULL, &len);    assert(ret == Z_STREAM_ERROR);
+    ret = inflateRestore(Z_NULL, buf, 0);       assert(ret == Z_STREAM_ERROR);
+    save("1f 8b 8 1e 0 0 0 0 2 0 2 0 78 79 6e 0 63 0 bc 92 34 50 87 11 c3 30"
+         " 10 5a 85 d5 28 fb cf 10 78 39 e7 93 f5 85 66 c7 26 a9 1d 31 ea 3b"
+         " 6b de b0 23 a0 b7 e3 7 c9 ad 84 a2 1c f6 92 5c 96 86 a1 7 1a 62 ec"
+         " c1 5b 8 59 77 72 c2 db 1 72 39 61 62 74 73 32 82 f5 38 c4 f3 7a 65"
+         " be ba 46 a9 96 46 ec d3 6 97 86 2f 28 cf fa 6 fb 88 25 3f 9f 5a 76"
+         " ec 4f 79 31 ea 98 e1 b7 a2 96 b4 ce c1 99 2f 42 4b 2c de 5f b7 7 f7"
+         " 23 e8 9f 92 13 4b e0 48 a1 24 23 55 21 37 b1 4 10 7 0 f8 ff 73 74"
+         " 6f 72 65 64 21 42 a4 3e c1 47 1 0 0", "save and restore",
+         0xc13ea442);
+
+    /* invalid saved states, made from the state of a new stream */
+    mem_setup(&strm);
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    ret = inflateInit2(&strm, -15);             assert(ret == Z_OK);
+    ret = inflateSave(&strm, buf, Z_NULL);      assert(ret == Z_STREAM_ERROR);
+    len = SAVED - 1;
+    ret = inflateSave(&strm, buf, &len);        assert(ret == Z_BUF_ERROR);
+    len = sizeof(buf);
+    ret = inflateSave(&strm, buf, &len);        assert(ret == Z_OK);
+    assert(len == SAVED);
+    ret = inflateRestore(&strm, Z_NULL, len);   assert(ret == Z_STREAM_ERROR);
+    ret = inflateRestore(&strm, buf, len - 1);  assert(ret == Z_DATA_ERROR);
+    ret = inflateRestore(&strm, buf, len + 1);  assert(ret == Z_DATA_ERROR);
+    buf[1] = SYNC - HEAD + 1;                   /* mode */
+    ret = inflateRestore(&strm, buf, len);      assert(ret == Z_DATA_ERROR);
+    buf[1] = LENEXT - HEAD;                     /* fixed tables */
+    buf[4] = 1;
+    buf[44] = 16;                               /* extra bits */
+    ret = inflateRestore(&strm, buf, len);      assert(ret == Z_DATA_ERROR);
+    buf[44] = 0;
+    ret = inflateRestore(&strm, buf, len);      assert(ret == Z_OK);
+    buf[1] = CODELENS - HEAD;                   /* over-subscribed */
+    buf[4] = 0;
+    memset(buf + SAVED, 1, 19);
+    ret = inflateRestore(&strm, buf, len + 19); assert(ret == Z_DATA_ERROR);
+    buf[SAVED] = 16;                            /* length too long */
+    ret = inflateRestore(&strm, buf, len + 19); assert(ret == Z_DATA_ERROR);
+    buf[SAVED] = 1;
+    buf[1] = LEN - HEAD;                        /* dynamic tables */
+    buf[4] = 2;
+    buf[6] = 3;                                 /* ndist */
+    buf[7] = 2;                                 /* nlen */
+    buf[19] = 1;                                /* havemulti */
+    ret = inflateRestore(&strm, buf, len + 5);  assert(ret == Z_DATA_ERROR);
+    buf[6] = 1;
+    buf[7] = 3;
+    ret = inflateRestore(&strm, buf, len + 4);  assert(ret == Z_DATA_ERROR);
+    buf[7] = 2;
+    ret = inflateRestore(&strm, buf, len + 3);  assert(ret == Z_OK);
+    buf[1] = 0;                                 /* window too big */
+    buf[4] = buf[6] = buf[7] = 0;
+    memset(buf + SAVED, 0, 257);
+    buf[2] = 8;
+    buf[11] = 1;
+    buf[12] = 1;
+    ret = inflateRestore(&strm, buf, len + 257);
+                                                assert(ret == Z_DATA_ERROR);
+    buf[2] = 9;
+    mem_limit(&strm, 1);
+    ret = inflateRestore(&strm, buf, len + 257);
+                                                assert(ret == Z_MEM_ERROR);
+    mem_limit(&strm, 0);
+    ret = inflateRestore(&strm, buf, len + 257);
+                                                assert(ret == Z_OK);
+    buf[2] = 10;                                /* new window size */
+    ret = inflateRestore(&strm, buf, len + 257);
+                                                assert(ret == Z_OK);
+    ret = inflateEnd(&strm);                    assert(ret == Z_OK);
+    mem_done(&strm, "invalid saved state");
+}
+
+/* cover the inflateSync() pattern search and inflateSyncFind() */
+local void cover_sync(void)
+{
+    int ret;
+    unsigned k;
+    z_size_t got, off[4];
+    unsigned char buf[200];
+    z_stream strm;
+
+    /* each alignment of the pattern in the C search of a short buffer */
+    for (k = 0; k < 8; k++) {
+        memset(buf, 0x55, 12);
+        memcpy(buf + k, "\0\0\xff\xff", 4);
+        got = inflateSyncFind(buf, 12, off, 4);
+        assert(got == 1 && off[0] == k + 4);
+        buf[k + 3] = 0;
+        got = inflateSyncFind(buf, 12, off, 4);  assert(got == 0);
+    }
+    got = inflateSyncFind(Z_NULL, 12, off, 4);  assert(got == 0);
+
+    /* patterns through a longer buffer, and more than max of them */
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, "\0\0\xff\xff", 4);
+    memcpy(buf + 37, "\0\0\xff\xff", 4);
+    memcpy(buf + 100, "\0\xff\xff\xff", 4);
+    memcpy(buf + 196, "\0\0\xff\xff", 4);
+    got = inflateSyncFind(buf, 200, off, 4);
+    assert(got == 4 && off[0] == 4 && off[1] == 41 && off[2] == 103 &&
+           off[3] == 200);
+    got = inflateSyncFind(buf, 200, off, 1);    assert(got == 4);
+    got = inflateSyncFind(buf, 200, Z_NULL, 0); assert(got == 4);
+
+    /* a pattern split across inflateSync() calls, after a long search */
+    mem_setup(&strm);
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    ret = inflateInit2(&strm, -15);             assert(ret == Z_OK);
+    memset(buf, 0x55, sizeof(buf));
+    buf[98] = buf[99] = 0;
+    strm.avail_in = 100;
+    strm.next_in = buf;
+    ret = inflateSync(&strm);                   assert(ret == Z_DATA_ERROR);
+    strm.avail_in = 100;
+    strm.next_in = buf + 100;
+    buf[100] = buf[101] = 0xff;
+    ret = inflateSync(&strm);                   assert(ret == Z_OK);
+    assert(strm.total_in == 102);
+    ret = inflateEnd(&strm);                    assert(ret == Z_OK);
+    mem_done(&strm, "sync search");
 }
 
 int main(void)
@@ -663,9 +1143,13 @@ int main(void)
     fprintf(stderr, "%s\n", zlibVersion());
     cover_support();
     cover_wrap();
+    cover_grow();
     cover_back();
     cover_inflate();
     cover_trees();
     cover_fast();
+    cover_direct();
+    cover_save();
+    cover_sync();
     return 0;
 }
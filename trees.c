@@ -176,9 +176,34 @@ local void gen_trees_header OF((void));
     put_byte(s, (uch)((ush)(w) >> 8)); \
 }
 
+/* ===========================================================================
+ * Output the full bit buffer w, Buf_size bits, LSB first on the stream.
+ * IN assertion: there is enough room in pendingBuf.
+ */
+#ifdef BIT64
+#  if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+      || defined(_WIN64)
+#    define put_buf(s, w) { \
+       zmemcpy(s->pending_buf + s->pending, (Bytef *)&(w), 8); \
+       s->pending += 8; \
+     }
+#  else
+#    define put_buf(s, w) { \
+       put_short(s, w); \
+       put_short(s, (w) >> 16); \
+       put_short(s, (w) >> 32); \
+       put_short(s, (w) >> 48); \
+     }
+#  endif
+#else
+#  define put_buf(s, w) put_short(s, w)
+#endif
+
 /* ===========================================================================
  * Send a value on a given number of bits.
  * IN assertion: length <= 16 and value fits in length bits.
+ * bi_valid is kept below Buf_size, so that the shifts are by less than the
+ * width of bi_buf.
  */
 #ifdef ZLIB_DEBUG
 local void send_bits      OF((deflate_state *s, int value, int length));
@@ -193,16 +218,16 @@ local void send_bits(s, value, length)
     s->bits_sent += (ulg)length;
 
     /* If not enough room in bi_buf, use (valid) bits from bi_buf and
-     * (16 - bi_valid) bits from value, leaving (width - (16-bi_valid))
-     * unused bits in value.
+     * (Buf_size - bi_valid) bits from value, leaving (width -
+     * (Buf_size - bi_valid)) unused bits in value.
      */
-    if (s->bi_valid > (int)Buf_size - length) {
-        s->bi_buf |= (ush)value << s->bi_valid;
-        put_short(s, s->bi_buf);
-        s->bi_buf = (ush)value >> (Buf_size - s->bi_valid);
+    if (s->bi_valid >= (int)Buf_size - length) {
+        s->bi_buf |= (BitBuf)value << s->bi_valid;
+        put_buf(s, s->bi_buf);
+        s->bi_buf = (BitBuf)value >> (Buf_size - s->bi_valid);
         s->bi_valid += length - Buf_size;
     } else {
-        s->bi_buf |= (ush)value << s->bi_valid;
+        s->bi_buf |= (BitBuf)value << s->bi_valid;
         s->bi_valid += length;
     }
 }
@@ -210,14 +235,14 @@ local void send_bits(s, value, length)
 
 #define send_bits(s, value, length) \
 { int len = length;\
-  if (s->bi_valid > (int)Buf_size - len) {\
-    int val = (int)value;\
-    s->bi_buf |= (ush)val << s->bi_valid;\
-    put_short(s, s->bi_buf);\
-    s->bi_buf = (ush)val >> (Buf_size - s->bi_valid);\
+  if (s->bi_valid >= (int)Buf_size - len) {\
+    BitBuf val = (BitBuf)(value);\
+    s->bi_buf |= val << s->bi_valid;\
+    put_buf(s, s->bi_buf);\
+    s->bi_buf = val >> (Buf_size - s->bi_valid);\
     s->bi_valid += len - Buf_size;\
   } else {\
-    s->bi_buf |= (ush)(value) << s->bi_valid;\
+    s->bi_buf |= (BitBuf)(value) << s->bi_valid;\
     s->bi_valid += len;\
   }\
 }
@@ -416,7 +441,7 @@ local void init_block(s)
 
     s->dyn_ltree[END_BLOCK].Freq = 1;
     s->opt_len = s->static_len = 0L;
-    s->last_lit = s->matches = 0;
+    s->sym_next = s->matches = 0;
 }
 
 #define SMALLEST 1
@@ -904,6 +929,92 @@ void ZLIB_INTERNAL _tr_align(s)
     bi_flush(s);
 }
 
+/* ===========================================================================
+ * Start a block coded with the static trees for deflate_quick(), which sends
+ * its literals and matches as it finds them with _tr_quick_lit() and
+ * _tr_quick_dist() instead of saving them with _tr_tally().
+ */
+void ZLIB_INTERNAL _tr_quick_start(s, last)
+    deflate_state *s;
+    int last;         /* one if this is the last block for a file */
+{
+    send_bits(s, (STATIC_TREES<<1)+last, 3);
+#ifdef ZLIB_DEBUG
+    s->compressed_len += 3;
+#endif
+}
+
+/* ===========================================================================
+ * Send a literal byte in a deflate_quick() block
+ */
+void ZLIB_INTERNAL _tr_quick_lit(s, c)
+    deflate_state *s;
+    unsigned c;       /* the literal byte */
+{
+    send_code(s, c, static_ltree);
+    Tracecv(isgraph(c), (stderr," '%c' ", c));
+#ifdef ZLIB_DEBUG
+    s->compressed_len += static_ltree[c].Len;
+#endif
+}
+
+/* ===========================================================================
+ * Send a match in a deflate_quick() block
+ */
+void ZLIB_INTERNAL _tr_quick_dist(s, dist, lc)
+    deflate_state *s;
+    unsigned dist;    /* distance of matched string */
+    unsigned lc;      /* match length */
+{
+    unsigned code;    /* the code to send */
+    int extra;        /* number of extra bits to send */
+
+    Assert(dist >= 1 && dist <= (unsigned)MAX_DIST(s) &&
+           lc >= MIN_MATCH && lc <= MAX_MATCH, "_tr_quick_dist: bad match");
+    lc -= MIN_MATCH;
+    code = _length_code[lc];
+    send_code(s, code+LITERALS+1, static_ltree); /* send the length code */
+    extra = extra_lbits[code];
+    if (extra != 0) {
+        lc -= base_length[code];
+        send_bits(s, lc, extra);       /* send the extra length bits */
+    }
+#ifdef ZLIB_DEBUG
+    s->compressed_len += static_ltree[code+LITERALS+1].Len + extra;
+#endif
+    dist--; /* dist is now the match distance - 1 */
+    code = d_code(dist);
+    send_code(s, code, static_dtree);   /* send the distance code */
+    extra = extra_dbits[code];
+    if (extra != 0) {
+        dist -= (unsigned)base_dist[code];
+        send_bits(s, dist, extra);      /* send the extra distance bits */
+    }
+#ifdef ZLIB_DEBUG
+    s->compressed_len += static_dtree[code].Len + extra;
+#endif
+}
+
+/* ===========================================================================
+ * End a deflate_quick() block, aligning on a byte boundary if it is the last.
+ */
+void ZLIB_INTERNAL _tr_quick_end(s, last)
+    deflate_state *s;
+    int last;         /* one if this is the last block for a file */
+{
+    send_code(s, END_BLOCK, static_ltree);
+#ifdef ZLIB_DEBUG
+    s->compressed_len += 7;
+#endif
+    Assert (s->compressed_len == s->bits_sent, "bad compressed size");
+    if (last) {
+        bi_windup(s);
+#ifdef ZLIB_DEBUG
+        s->compressed_len = (s->compressed_len + 7) & (ulg)~7L;
+#endif
+    }
+}
+
 /* ===========================================================================
  * Determine the best encoding for the current block: dynamic trees, static
  * trees or store, and write out the encoded block.
@@ -947,7 +1058,7 @@ void ZLIB_INTERNAL _tr_flush_block(s, buf, stored_len, last)
 
         Tracev((stderr, "\nopt %lu(%lu) stat %lu(%lu) stored %lu lit %u ",
                 opt_lenb, s->opt_len, static_lenb, s->static_len, stored_len,
-                s->last_lit));
+                s->sym_next / 3));
 
         if (static_lenb <= opt_lenb) opt_lenb = static_lenb;
 
@@ -1016,8 +1127,9 @@ int ZLIB_INTERNAL _tr_tally (s, dist, lc)
     unsigned dist;  /* distance of matched string */
     unsigned lc;    /* match length-MIN_MATCH or unmatched char (if dist==0) */
 {
-    s->d_buf[s->last_lit] = (ush)dist;
-    s->l_buf[s->last_lit++] = (uch)lc;
+    s->sym_buf[s->sym_next++] = (uch)dist;
+    s->sym_buf[s->sym_next++] = (uch)(dist >> 8);
+    s->sym_buf[s->sym_next++] = (uch)lc;
     if (dist == 0) {
         /* lc is the unmatched char */
         s->dyn_ltree[lc].Freq++;
@@ -1035,9 +1147,9 @@ int ZLIB_INTERNAL _tr_tally (s, dist, lc)
 
 #ifdef TRUNCATE_BLOCK
     /* Try to guess if it is profitable to stop the current block here */
-    if ((s->last_lit & 0x1fff) == 0 && s->level > 2) {
+    if ((s->sym_next / 3 & 0x1fff) == 0 && s->level > 2) {
         /* Compute an upper bound for the compressed length */
-        ulg out_length = (ulg)s->last_lit*8L;
+        ulg out_length = (ulg)(s->sym_next / 3)*8L;
         ulg in_length = (ulg)((long)s->strstart - s->block_start);
         int dcode;
         for (dcode = 0; dcode < D_CODES; dcode++) {
@@ -1045,17 +1157,13 @@ int ZLIB_INTERNAL _tr_tally (s, dist, lc)
                 (5L+extra_dbits[dcode]);
         }
         out_length >>= 3;
-        Tracev((stderr,"\nlast_lit %u, in %ld, out ~%ld(%ld%%) ",
-               s->last_lit, in_length, out_length,
+        Tracev((stderr,"\nsymbols %u, in %ld, out ~%ld(%ld%%) ",
+               s->sym_next / 3, in_length, out_length,
                100L - out_length*100L/in_length));
-        if (s->matches < s->last_lit/2 && out_length < in_length/2) return 1;
+        if (s->matches < s->sym_next/6 && out_length < in_length/2) return 1;
     }
 #endif
-    return (s->last_lit == s->lit_bufsize-1);
-    /* We avoid equality with lit_bufsize because of wraparound at 64K
-     * on 16 bit machines and because stored blocks are restricted to
-     * 64K-1 bytes.
-     */
+    return (s->sym_next == s->sym_end);
 }
 
 /* ===========================================================================
@@ -1068,13 +1176,14 @@ local void compress_block(s, ltree, dtree)
 {
     unsigned dist;      /* distance of matched string */
     int lc;             /* match length or unmatched char (if dist == 0) */
-    unsigned lx = 0;    /* running index in l_buf */
+    unsigned sx = 0;    /* running index in sym_buf */
     unsigned code;      /* the code to send */
     int extra;          /* number of extra bits to send */
 
-    if (s->last_lit != 0) do {
-        dist = s->d_buf[lx];
-        lc = s->l_buf[lx++];
+    if (s->sym_next != 0) do {
+        dist = s->sym_buf[sx++];
+        dist += (unsigned)s->sym_buf[sx++] << 8;
+        lc = s->sym_buf[sx++];
         if (dist == 0) {
             send_code(s, lc, ltree); /* send a literal byte */
             Tracecv(isgraph(lc), (stderr," '%c' ", lc));
@@ -1099,11 +1208,10 @@ local void compress_block(s, ltree, dtree)
             }
         } /* literal or match pair ? */
 
-        /* Check that the overlay between pending_buf and d_buf+l_buf is ok: */
-        Assert((uInt)(s->pending) < s->lit_bufsize + 2*lx,
-               "pendingBuf overflow");
+        /* Check that the overlay between pending_buf and sym_buf is ok: */
+        Assert(s->pending < s->lit_bufsize + sx, "pendingBuf overflow");
 
-    } while (lx < s->last_lit);
+    } while (sx < s->sym_next);
 
     send_code(s, END_BLOCK, ltree);
 }
@@ -1173,11 +1281,7 @@ local unsigned bi_reverse(code, len)
 local void bi_flush(s)
     deflate_state *s;
 {
-    if (s->bi_valid == 16) {
-        put_short(s, s->bi_buf);
-        s->bi_buf = 0;
-        s->bi_valid = 0;
-    } else if (s->bi_valid >= 8) {
+    while (s->bi_valid >= 8) {
         put_byte(s, (Byte)s->bi_buf);
         s->bi_buf >>= 8;
         s->bi_valid -= 8;
@@ -1190,10 +1294,10 @@ local void bi_flush(s)
 local void bi_windup(s)
     deflate_state *s;
 {
-    if (s->bi_valid > 8) {
-        put_short(s, s->bi_buf);
-    } else if (s->bi_valid > 0) {
+    while (s->bi_valid > 0) {
         put_byte(s, (Byte)s->bi_buf);
+        s->bi_buf >>= 8;
+        s->bi_valid -= 8;
     }
     s->bi_buf = 0;
     s->bi_valid = 0;
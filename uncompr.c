@@ -54,6 +54,7 @@ int ZEXPORT uncompress2 (dest, destLen, source, sourceLen)
 
     err = inflateInit(&stream);
     if (err != Z_OK) return err;
+    inflateDirect(&stream, 1);  /* all of the output is at dest */
 
     stream.next_out = dest;
     stream.avail_out = 0;
@@ -53,8 +53,12 @@
 #  define deflatePrime          z_deflatePrime
 #  define deflateReset          z_deflateReset
 #  define deflateResetKeep      z_deflateResetKeep
+#  define deflateRestore        z_deflateRestore
+#  define deflateSave           z_deflateSave
 #  define deflateSetDictionary  z_deflateSetDictionary
+#  define deflateSetHash        z_deflateSetHash
 #  define deflateSetHeader      z_deflateSetHeader
+#  define deflateSetMatch       z_deflateSetMatch
 #  define deflateTune           z_deflateTune
 #  define deflate_copyright     z_deflate_copyright
 #  define get_crc_table         z_get_crc_table
@@ -105,6 +109,7 @@
 #  define inflateBackInit_      z_inflateBackInit_
 #  define inflateCodesUsed      z_inflateCodesUsed
 #  define inflateCopy           z_inflateCopy
+#  define inflateDirect         z_inflateDirect
 #  define inflateEnd            z_inflateEnd
 #  define inflateGetDictionary  z_inflateGetDictionary
 #  define inflateGetHeader      z_inflateGetHeader
@@ -117,8 +122,11 @@
 #  define inflateReset          z_inflateReset
 #  define inflateReset2         z_inflateReset2
 #  define inflateResetKeep      z_inflateResetKeep
+#  define inflateRestore        z_inflateRestore
+#  define inflateSave           z_inflateSave
 #  define inflateSetDictionary  z_inflateSetDictionary
 #  define inflateSync           z_inflateSync
+#  define inflateSyncFind       z_inflateSyncFind
 #  define inflateSyncPoint      z_inflateSyncPoint
 #  define inflateUndermine      z_inflateUndermine
 #  define inflateValidate       z_inflateValidate
@@ -277,10 +285,15 @@
  the default memory requirements from 256K to 128K, compile with
      make CFLAGS="-O -DMAX_WBITS=14 -DMAX_MEM_LEVEL=7"
  Of course this will generally degrade compression (there's no free lunch).
-
-   The memory requirements for inflate are (in bytes) 1 << windowBits
- that is, 32K for windowBits=15 (default value) plus about 7 kilobytes
- for small objects.
+ Levels 7 and up use another (1 << (windowBits+2)) for the tree match finder,
+ if deflateSetMatch() selects it, and level 10 uses up to another 512K for its
+ optimal parsing.
+
+   The memory requirements for inflate are (in bytes) up to 1 << windowBits
+ that is, 32K for windowBits=15 (default value), less for streams with less
+ than that much output, plus about 8 kilobytes for small objects, and 16K
+ for the multiple literal decoding table once a long dynamic block is seen,
+ unless compiled with -DNO_MULTI.
 */
 
                         /* Type declarations */
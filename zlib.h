@@ -200,6 +200,16 @@ typedef gz_header FAR *gz_headerp;
 #define Z_DEFAULT_STRATEGY    0
 /* compression strategy; see deflateInit2() below for details */
 
+#define Z_HASH_DEFAULT        0
+#define Z_HASH_MULTIPLY       1
+#define Z_HASH_CRC32C         2
+/* string hash method; see deflateSetHash() below for details */
+
+#define Z_MATCH_DEFAULT       0
+#define Z_MATCH_CHAIN         1
+#define Z_MATCH_TREE          2
+/* match finder; see deflateSetMatch() below for details */
+
 #define Z_BINARY   0
 #define Z_TEXT     1
 #define Z_ASCII    Z_TEXT   /* for compatibility with 1.2.2 and earlier */
@@ -236,7 +246,11 @@ ZEXTERN int ZEXPORT deflateInit OF((z_streamp strm, int level));
    1 gives best speed, 9 gives best compression, 0 gives no compression at all
    (the input data is simply copied a block at a time).  Z_DEFAULT_COMPRESSION
    requests a default compromise between speed and compression (currently
-   equivalent to level 6).
+   equivalent to level 6).  Level 10 compresses better than level 9 by
+   choosing among all of the matches found with an estimate of their cost in
+   bits, for data that is compressed once and decompressed many times.  It
+   is many times slower than level 9, and uses up to another 512K of memory.
+   Earlier versions of zlib do not accept level 10.
 
      deflateInit returns Z_OK if success, Z_MEM_ERROR if there was not enough
    memory, Z_STREAM_ERROR if level is not a valid compression level, or
@@ -382,8 +396,10 @@ ZEXTERN int ZEXPORT inflateInit OF((z_streamp strm));
    the caller.  In the current version of inflate, the provided input is not
    read or consumed.  The allocation of a sliding window will be deferred to
    the first call of inflate (if the decompression does not complete on the
-   first call).  If zalloc and zfree are set to Z_NULL, inflateInit updates
-   them to use default allocation functions.
+   first call).  The window starts only as large as the output so far needs,
+   at least 256 bytes, and is enlarged by later calls of inflate as more
+   output is produced, up to the full window size.  If zalloc and zfree are set
+   to Z_NULL, inflateInit updates them to use default allocation functions.
 
      inflateInit returns Z_OK if success, Z_MEM_ERROR if there was not enough
    memory, Z_VERSION_ERROR if the zlib library version is incompatible with the
@@ -598,7 +614,9 @@ ZEXTERN int ZEXPORT deflateInit2 OF((z_streamp strm,
    strategy parameter only affects the compression ratio but not the
    correctness of the compressed output even if it is not set appropriately.
    Z_FIXED prevents the use of dynamic Huffman codes, allowing for a simpler
-   decoder for special applications.
+   decoder for special applications.  At level 1, Z_FIXED also selects a
+   faster compressor that writes each literal and match out as it is found,
+   and checks only one prior string for each match.
 
      deflateInit2 returns Z_OK if success, Z_MEM_ERROR if there was not enough
    memory, Z_STREAM_ERROR if any parameter is invalid (such as an invalid
@@ -692,6 +710,63 @@ ZEXTERN int ZEXPORT deflateCopy OF((z_streamp dest,
    destination.
 */
 
+ZEXTERN int ZEXPORT deflateSave OF((z_streamp strm,
+                                    Bytef *buf,
+                                    uInt *len));
+/*
+     Saves the state of strm in buf, as a sequence of bytes with no pointers,
+   and sets *len to the number of bytes saved.  The saved state is the pending
+   output, the history of up to the window size, and the settings, but not the
+   hash tables, the input or output buffers, or the header structure given to
+   deflateSetHeader().  After saving, the application can end the stream with
+   deflateEnd() to free its memory, which returns Z_DATA_ERROR for a stream
+   not yet finished, and later resume it with deflateRestore().
+   This can keep many idle streams that use their history, such as those of
+   WebSocket permessage-deflate with context takeover, in a fraction of the
+   memory of the streams.  If buf is Z_NULL, then only *len is set, to the
+   number of bytes needed.  Otherwise *len must be at least that number on
+   entry.
+
+     deflateSave() can be used only at a flush point, with all of the input
+   provided so far compressed.  That is before the first deflate() call, or
+   after a deflate() call with a flush parameter other than Z_NO_FLUSH that
+   consumed all of the input and completed the flush, returning with avail_out
+   not zero, or with Z_STREAM_END.  It may also work after the output buffer
+   fills during the flush, in which case the output not yet delivered is saved.
+   If a gzip header is given with deflateSetHeader(), then the stream can be
+   saved only before the first deflate() call or after the header is written.
+
+     deflateSave returns Z_OK on success, Z_BUF_ERROR if *len is too small, or
+   Z_STREAM_ERROR if the stream state was inconsistent, the stream is not at a
+   flush point, or len is Z_NULL.
+*/
+
+ZEXTERN int ZEXPORT deflateRestore OF((z_streamp strm,
+                                       const Bytef *buf,
+                                       uInt len));
+/*
+     Restores the state saved by deflateSave() in the len bytes at buf to strm,
+   which must have been initialized with deflateInit() or deflateInit2() with
+   the same window size.  The level, strategy, wrap, and all of the other state
+   of strm are replaced by the saved state, including the settings of
+   deflateTune(), deflateSetHash(), and deflateSetMatch(), and total_in,
+   total_out, and adler.  The memLevel can differ, as long as there is room for
+   the pending output.  The state can be restored in a different process than
+   the one that saved it, with the same zlib library.  deflate() then continues
+   the stream with the application's next input and output, hashing the saved
+   history as that input arrives.  Since the hash tables start over, the
+   compressed data may differ from that of a stream that was not saved, though
+   it decompresses to the same data.  If the gzip header had not been written
+   when the stream was saved, then deflateSetHeader() must be called again
+   after deflateRestore() to give it the header.
+
+     deflateRestore returns Z_OK on success, Z_DATA_ERROR if the saved state is
+   not valid or is for a different window size, Z_MEM_ERROR if there was not
+   enough memory for the saved level and match finder, or Z_STREAM_ERROR if the
+   stream state was inconsistent or buf is Z_NULL.  On an error, strm is left
+   unchanged.
+*/
+
 ZEXTERN int ZEXPORT deflateReset OF((z_streamp strm));
 /*
      This function is equivalent to deflateEnd followed by deflateInit, but
@@ -714,9 +789,9 @@ ZEXTERN int ZEXPORT deflateParams OF((z_streamp strm,
    If the compression approach (which is a function of the level) or the
    strategy is changed, and if any input has been consumed in a previous
    deflate() call, then the input available so far is compressed with the old
-   level and strategy using deflate(strm, Z_BLOCK).  There are three approaches
-   for the compression levels 0, 1..3, and 4..9 respectively.  The new level
-   and strategy will take effect at the next call of deflate().
+   level and strategy using deflate(strm, Z_BLOCK).  There are five approaches
+   for the compression levels 0, 1..3, 4..5, 6..9, and 10 respectively.  The
+   new level and strategy will take effect at the next call of deflate().
 
      If a deflate(strm, Z_BLOCK) is performed by deflateParams(), and it does
    not have enough output space to complete, then the parameter change will not
@@ -732,7 +807,8 @@ ZEXTERN int ZEXPORT deflateParams OF((z_streamp strm,
    applied to the the data compressed after deflateParams().
 
      deflateParams returns Z_OK on success, Z_STREAM_ERROR if the source stream
-   state was inconsistent or if a parameter was invalid, or Z_BUF_ERROR if
+   state was inconsistent or if a parameter was invalid, Z_MEM_ERROR if there
+   was not enough memory for level 10, or Z_BUF_ERROR if
    there was not enough output space to complete the compression of the
    available input data before a change in the strategy or approach.  Note that
    in the case of a Z_BUF_ERROR, the parameters are not changed.  A return
@@ -757,6 +833,57 @@ ZEXTERN int ZEXPORT deflateTune OF((z_streamp strm,
    returns Z_OK on success, or Z_STREAM_ERROR for an invalid deflate stream.
  */
 
+ZEXTERN int ZEXPORT deflateSetHash OF((z_streamp strm,
+                                       int method));
+/*
+     Select the hash function that deflate uses to find earlier occurrences of
+   the string at the current position.  Z_HASH_DEFAULT, the hash used by every
+   version of zlib, hashes three bytes.  Z_HASH_MULTIPLY and Z_HASH_CRC32C hash
+   four bytes at a time, which spreads structured data such as JSON or
+   protocol buffers over more of the hash table.  The resulting shorter hash
+   chains make compression faster for levels 1 through 9, at the cost of
+   mostly missing matches of only three bytes.  Z_HASH_CRC32C uses the SSE4.2
+   crc32 instruction if the processor has it, and is otherwise the same as
+   Z_HASH_MULTIPLY.  The output is always valid deflate data, but it depends on
+   the method, and for Z_HASH_CRC32C on the processor.
+
+     deflateSetHash() must be called after deflateInit(), deflateInit2(), or
+   deflateReset(), and before deflateSetDictionary() or the first call of
+   deflate() with input.  The method is retained by deflateReset().
+   deflateSetHash() returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state is inconsistent, method is not valid, or input has already been
+   hashed.
+*/
+
+ZEXTERN int ZEXPORT deflateSetMatch OF((z_streamp strm,
+                                        int method));
+/*
+     Select how deflate finds the earlier occurrences of the string at the
+   current position for levels 7 through 10.  Z_MATCH_CHAIN follows a list of
+   the earlier strings with the same hash, from the most recent, which is
+   what every version of zlib before this one did.  Z_MATCH_TREE instead
+   keeps those strings in a sorted binary tree, so finding the longest match
+   takes a number of steps proportional to the logarithm of the number of
+   strings instead.  That is several times faster for data with many partial
+   repeats, such as DNA sequences, where the chains get long, and at level
+   10, which looks at every match.  It is slower for most other data at
+   levels 7 through 9, and much slower for data with many long repeats, since
+   every string is sorted into the tree, even those inside a match.  The tree
+   takes another (1 << (windowBits+2)) bytes of memory.  Z_MATCH_DEFAULT uses
+   the chains, as does Z_MATCH_CHAIN.  Levels 1 through 6 always use the
+   chains.  When deflateParams() changes between a level that uses the chains
+   and one that uses the tree, the strings already seen are forgotten, so the
+   next matches can only be to later input.  The output is always valid
+   deflate data, but it depends on the method.
+
+     deflateSetMatch() must be called after deflateInit(), deflateInit2(), or
+   deflateReset(), and before deflateSetDictionary() or the first call of
+   deflate() with input.  The method is retained by deflateReset().
+   deflateSetMatch() returns Z_OK on success, Z_MEM_ERROR if there was not
+   enough memory for the tree, or Z_STREAM_ERROR if the stream state is
+   inconsistent, method is not valid, or input has already been hashed.
+*/
+
 ZEXTERN uLong ZEXPORT deflateBound OF((z_streamp strm,
                                        uLong sourceLen));
 /*
@@ -938,6 +1065,20 @@ ZEXTERN int ZEXPORT inflateSync OF((z_streamp strm));
    input each time, until success or end of the input data.
 */
 
+ZEXTERN z_size_t ZEXPORT inflateSyncFind OF((const Bytef *buf, z_size_t len,
+                                             z_size_t *offsets, z_size_t max));
+/*
+     Finds every 00 00 FF FF pattern in buf[0..len-1], the possible full flush
+   points that inflateSync() would stop at, in one call.  The offset in buf of
+   the byte after each pattern, where inflateSync() would leave next_in, is
+   saved in offsets[], up to max of them in order.  inflateSyncFind returns the
+   number of patterns found, which can be more than max, or zero if buf is
+   Z_NULL.  Patterns that span two buffers are not found, and some patterns
+   found may not be flush points.  An application splitting a stream for
+   parallel decompression can start a raw inflate (see inflateInit2) at the
+   offset of each full flush point.
+*/
+
 ZEXTERN int ZEXPORT inflateCopy OF((z_streamp dest,
                                     z_streamp source));
 /*
@@ -954,6 +1095,48 @@ ZEXTERN int ZEXPORT inflateCopy OF((z_streamp dest,
    destination.
 */
 
+ZEXTERN int ZEXPORT inflateSave OF((z_streamp strm,
+                                    Bytef *buf,
+                                    uInt *len));
+/*
+     Saves the state of strm in buf, as a sequence of bytes with no pointers,
+   and sets *len to the number of bytes saved.  The saved state includes the
+   history needed for the rest of the stream, of up to the window size, but
+   not the input or output buffers, or the header structure given to
+   inflateGetHeader().  inflateSave() can be used between any two inflate()
+   calls.  After saving, the application can end the stream with inflateEnd()
+   to free its memory, and later resume it with inflateRestore().  The saved
+   state is usually much smaller than the memory used by the stream, since the
+   code tables are saved as their code lengths, and there is no unused window.
+   If buf is Z_NULL, then only *len is set, to the number of bytes needed.
+   Otherwise *len must be at least that number on entry, which is never more
+   than the window size plus 512 bytes.
+
+     inflateSave returns Z_OK on success, Z_BUF_ERROR if *len is too small, or
+   Z_STREAM_ERROR if the stream state was inconsistent or len is Z_NULL.
+*/
+
+ZEXTERN int ZEXPORT inflateRestore OF((z_streamp strm,
+                                       const Bytef *buf,
+                                       uInt len));
+/*
+     Restores the state saved by inflateSave() in the len bytes at buf to strm,
+   which must have been initialized with inflateInit() or inflateInit2(), with
+   any window size and wrap.  Those settings and all of the state of strm are
+   replaced by the saved state, including total_in, total_out, and adler.  The
+   state can be restored in a different process than the one that saved it,
+   with the same zlib library.  inflate() then continues the stream with the
+   application's next input and output.  The stream is not in direct mode
+   after a restore, even if it was when saved.  If a gzip header is being
+   saved with inflateGetHeader(), then inflateGetHeader() must be called again
+   after inflateRestore() for the rest of the header.
+
+     inflateRestore returns Z_OK on success, Z_DATA_ERROR if the saved state is
+   not valid, Z_MEM_ERROR if there was not enough memory for the window, or
+   Z_STREAM_ERROR if the stream state was inconsistent or buf is Z_NULL.  On
+   an error other than Z_STREAM_ERROR, strm is reset as by inflateReset().
+*/
+
 ZEXTERN int ZEXPORT inflateReset OF((z_streamp strm));
 /*
      This function is equivalent to inflateEnd followed by inflateInit,
@@ -978,6 +1161,34 @@ ZEXTERN int ZEXPORT inflateReset2 OF((z_streamp strm,
    the windowBits parameter is invalid.
 */
 
+ZEXTERN int ZEXPORT inflateDirect OF((z_streamp strm,
+                                      int direct));
+/*
+     If direct is non-zero, the application promises that the output of each
+   inflate() call will follow immediately after the output of the call before
+   it, in one buffer that is left untouched until the stream is done.
+   inflate() then copies matches from the earlier output where it is, instead
+   of keeping the last 32K of output in a sliding window.  No window is
+   allocated, and the output is not copied to one at the end of each call.
+   This is for decompressing to a single large buffer when the input arrives
+   a piece at a time, or when inflate() is called without Z_FINISH.
+   (inflate() already does without the window when Z_FINISH is used and the
+   stream completes in that call.)  uncompress() and uncompress2() use this.
+   If the earlier output is moved or changed, inflate() will produce
+   incorrect data, or may read memory outside of the buffer.
+
+     inflateDirect() must be called after inflateInit(), inflateInit2(), or
+   inflateReset(), and before inflate() writes any output.  The setting is
+   retained by inflateReset().  inflateSetDictionary() turns it off, copying
+   the output so far to a new window.  inflateGetDictionary() returns the
+   earlier output in place.  A copy made with inflateCopy() also depends on the
+   earlier output before its next_out.
+
+     inflateDirect returns Z_OK on success, or Z_STREAM_ERROR if the source
+   stream state was inconsistent, or if inflate() has already written output
+   or a dictionary has been set.
+*/
+
 ZEXTERN int ZEXPORT inflatePrime OF((z_streamp strm,
                                      int bits,
                                      int value));
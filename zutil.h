@@ -46,6 +46,17 @@ typedef unsigned short ush;
 typedef ush FAR ushf;
 typedef unsigned long  ulg;
 
+/* BIT64 is a 64-bit type for the bit buffers of deflate and inflate, so that
+   they can write or read eight bytes at a time.  Compile with -DNO_BIT64 to
+   use the narrower bit buffers instead. */
+#ifndef NO_BIT64
+#  if defined(__LP64__) || defined(_LP64)
+#    define BIT64 unsigned long
+#  elif defined(_WIN64)
+#    define BIT64 unsigned __int64
+#  endif
+#endif
+
 extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
 /* (size given to avoid silly warnings with Visual C++) */
 